@@ -37,9 +37,15 @@
 
 #include "rt/rt_api.h"
 
+// The allocator descriptors are recycled through a pool at each open / close
+// to not fragment the FC memory
+static rt_pool_t __rt_hyperram_alloc_pool;
+
 int __rt_hyperram_init(rt_hyperram_t *hyper)
 {
-  rt_extern_alloc_t *alloc = (rt_extern_alloc_t *)rt_alloc(RT_ALLOC_FC_DATA, sizeof(rt_extern_alloc_t));
+  int irq = hal_irq_disable();
+  rt_extern_alloc_t *alloc = (rt_extern_alloc_t *)rt_pool_alloc(&__rt_hyperram_alloc_pool);
+  hal_irq_restore(irq);
   if (alloc == NULL) return -1;
 
   hyper->alloc = alloc;
@@ -56,7 +62,13 @@ void rt_hyperram_conf_init(rt_hyperram_conf_t *conf)
 static void __rt_hyperram_free(rt_hyperram_t *hyper)
 {
   if (hyper != NULL) {
-    if (hyper->alloc != NULL) rt_free(RT_ALLOC_FC_DATA, (void *)hyper, sizeof(rt_extern_alloc_t));
+    if (hyper->alloc != NULL)
+    {
+      rt_extern_alloc_deinit(hyper->alloc);
+      int irq = hal_irq_disable();
+      rt_pool_free(&__rt_hyperram_alloc_pool, (void *)hyper->alloc);
+      hal_irq_restore(irq);
+    }
     rt_free(RT_ALLOC_FC_DATA, (void *)hyper, sizeof(rt_hyperram_t));
   }
 }
@@ -143,3 +155,9 @@ void __rt_hyper_copy(int channel,
 
   __rt_wait_event_check(event, call_event);
 }
+
+
+RT_FC_BOOT_CODE void __attribute__((constructor)) __rt_hyperram_init_pool()
+{
+  rt_pool_init(&__rt_hyperram_alloc_pool, RT_ALLOC_FC_DATA, sizeof(rt_extern_alloc_t), 1);
+}
@@ -36,6 +36,12 @@
 
 #include "rt/rt_api.h"
 
+// File descriptors are often opened and closed, they are recycled through a pool
+// to not fragment the FC memory
+static rt_pool_t __rt_fs_file_pool;
+
+// Same for file-system descriptors, which are recycled at each mount / unmount
+static rt_pool_t __rt_fs_pool;
 
 
 // Called by global rt_error_str to display fs errors
@@ -91,11 +97,15 @@ static void __rt_fs_free(rt_fs_t *fs)
     if (fs->flash) rt_flash_close(fs->flash, NULL);
     if (fs->fs_l2) rt_free(RT_ALLOC_PERIPH, fs->fs_l2, sizeof(rt_fs_l2_t));
     if (fs->cache) rt_free(RT_ALLOC_PERIPH, fs->cache, FS_READ_THRESHOLD_BLOCK_FULL);
+
+    int irq = hal_irq_disable();
+    rt_pool_free(&__rt_fs_pool, (void *)fs);
+    hal_irq_restore(irq);
   }
 }
 
 
-// This function can be called to do all the required asynchronous steps to mount a FS.
+// This continuation does all the required asynchronous steps to mount a FS.
 // This can execute in 2 ways:
 //   - No event is given in which case each call is synchronous and the call 
 //     to this function will just do all steps in one shot
@@ -106,65 +116,45 @@ static int __rt_fs_mount_step(void *arg)
 {
   rt_fs_t *fs = (rt_fs_t *)arg;
 
-  // Loop on all steps in case there synchronous steps
-  while (fs->mount_step < 4)
-  {
-    // Each asynchronous step is given fs->step_event which is an intermediate event
-    // to reenqueue this function and do everything asynchronously.
-    // It can also be NULL to do everything synchronously
-    switch (fs->mount_step)
-    {
-      case 0:
-        // Open the flash
-        fs->flash = rt_flash_open((char *)fs->dev_name, NULL, fs->step_event);
-        if (fs->flash == NULL) {
-          __rt_fs_abort(
-            fs->pending_event, RT_FS_MOUNT_FLASH_ERROR, (void *)fs
-          );
-          goto error;
-        }
-        break;
-
-      case 1:
-        // Read the offset telling where is the file-system header
-        rt_flash_read(fs->flash, &fs->fs_l2->fs_offset, 0, 4, fs->step_event);
-        break;
-
-      case 2:
-        // Read the header size at the first header word
-        rt_flash_read(fs->flash, &fs->fs_l2->fs_size, (void *)fs->fs_l2->fs_offset, 4, fs->step_event);
-        break;
-
-      case 3: {
-        // Allocate roon for the file-system header and read it
-        int fs_size = fs->fs_l2->fs_size;
-        int fs_offset = fs->fs_l2->fs_offset;
-        fs->fs_info = rt_alloc(RT_ALLOC_PERIPH, fs_size);
-        if (fs->fs_info == NULL) {
-          __rt_fs_abort(fs->pending_event, RT_FS_MOUNT_MEM_ERROR, (void *)fs);
-          goto error;
-        }
-        rt_flash_read(fs->flash, (void *)fs->fs_info, (void *)(fs_offset + 4), fs_size, fs->step_event);
-        break;
-      }
-    }
-
-    fs->mount_step++;
-
-    // Only continue to execute other steps if no event is provided as it 
-    // is then synchonous
-    if (fs->step_event != NULL) goto end;
+  // Each asynchronous step is given fs->step_event which is an intermediate event
+  // to resume this function and do everything asynchronously.
+  // It can also be NULL to do everything synchronously
+  rt_event_t *event = fs->step_event;
+
+  RT_ASYNC_BEGIN(&fs->async);
+
+  // Open the flash
+  fs->flash = rt_flash_open((char *)fs->dev_name, NULL, event);
+  if (fs->flash == NULL) {
+    __rt_fs_abort(
+      fs->pending_event, RT_FS_MOUNT_FLASH_ERROR, (void *)fs
+    );
+    RT_ASYNC_EXIT(&fs->async, -1);
   }
+  RT_ASYNC_AWAIT(&fs->async, event);
+
+  // Read the offset telling where is the file-system header
+  rt_flash_read(fs->flash, &fs->fs_l2->fs_offset, 0, 4, event);
+  RT_ASYNC_AWAIT(&fs->async, event);
+
+  // Read the header size at the first header word
+  rt_flash_read(fs->flash, &fs->fs_l2->fs_size, (void *)fs->fs_l2->fs_offset, 4, event);
+  RT_ASYNC_AWAIT(&fs->async, event);
+
+  // Allocate roon for the file-system header and read it
+  fs->fs_info = rt_alloc(RT_ALLOC_PERIPH, fs->fs_l2->fs_size);
+  if (fs->fs_info == NULL) {
+    __rt_fs_abort(fs->pending_event, RT_FS_MOUNT_MEM_ERROR, (void *)fs);
+    RT_ASYNC_EXIT(&fs->async, -1);
+  }
+  rt_flash_read(fs->flash, (void *)fs->fs_info, (void *)(fs->fs_l2->fs_offset + 4), fs->fs_l2->fs_size, event);
+  RT_ASYNC_AWAIT(&fs->async, event);
 
   // In case there was a user event specified, enqueue it now that all
   // steps are done to notify the user
-  if (fs->step_event) rt_event_enqueue(fs->pending_event);
-
-end:
-  return 0;
+  if (event) rt_event_enqueue(fs->pending_event);
 
-error:
-  return -1;
+  RT_ASYNC_END(&fs->async);
 }
 
 void rt_fs_unmount(rt_fs_t *fs, rt_event_t *event)
@@ -190,7 +180,9 @@ rt_fs_t *rt_fs_mount(const char *dev_name, rt_fs_conf_t *conf, rt_event_t *event
 
   rt_trace(RT_TRACE_DEV_CTRL, "[FS] Mounting file-system (device: %s)\n", dev_name);
 
-  rt_fs_t *fs = rt_alloc(RT_ALLOC_FC_DATA, sizeof(rt_fs_t));
+  int irq = hal_irq_disable();
+  rt_fs_t *fs = rt_pool_alloc(&__rt_fs_pool);
+  hal_irq_restore(irq);
   if (fs == NULL) goto error;
 
   // Initialize all fields where something needs to be closed in case of error
@@ -205,7 +197,6 @@ rt_fs_t *rt_fs_mount(const char *dev_name, rt_fs_conf_t *conf, rt_event_t *event
   fs->cache = rt_alloc(RT_ALLOC_PERIPH, FS_READ_THRESHOLD_BLOCK_FULL);
   if (fs->cache == NULL) goto error;
 
-  fs->mount_step = 0;
   fs->dev_name = dev_name;
   fs->fs_info = NULL;
   fs->pending_event = event;
@@ -214,8 +205,9 @@ rt_fs_t *rt_fs_mount(const char *dev_name, rt_fs_conf_t *conf, rt_event_t *event
   // asynchronously with another event, otherwise just do everything
   // synchronously with no event
   if (event) {
-    fs->step_event = __rt_init_event(&fs->event, event->sched, (void (*)(void *))__rt_fs_mount_step, (void *)fs);
+    fs->step_event = rt_async_init(&fs->async, event->sched, __rt_fs_mount_step, (void *)fs);
   } else {
+    rt_async_init(&fs->async, NULL, __rt_fs_mount_step, (void *)fs);
     fs->step_event = NULL;
   }
 
@@ -257,7 +249,9 @@ rt_file_t *rt_fs_open(rt_fs_t *fs, const char *file_name, int flags, rt_event_t
   if (i == nb_comps) goto error;
 
   // Now allocate the file descriptor and fills it
-  rt_file_t *file = rt_alloc(RT_ALLOC_FC_DATA, sizeof(rt_file_t));
+  int irq = hal_irq_disable();
+  rt_file_t *file = rt_pool_alloc(&__rt_fs_file_pool);
+  hal_irq_restore(irq);
   if (file == NULL) goto error;
 
   file->offset = 0;
@@ -274,7 +268,9 @@ error:
 void rt_fs_close(rt_file_t *file, rt_event_t *event)
 {
   rt_trace(RT_TRACE_FS, "[FS] Closing file (file: %p)\n", file);
-  rt_free(RT_ALLOC_FC_DATA, (void *)file, sizeof(rt_file_t));
+  int irq = hal_irq_disable();
+  rt_pool_free(&__rt_fs_file_pool, (void *)file);
+  hal_irq_restore(irq);
 }
 
 
@@ -373,22 +369,25 @@ int rt_fs_seek(rt_file_t *file, unsigned int offset)
   return -1;
 }
 
-// This function can be called to do all the required asynchronous steps to mount a FS.
+// This continuation does all the required asynchronous steps to read a file.
 // This can execute in 2 ways:
 //   - No event is given in which case each call is synchronous and the call 
 //     to this function will just do all steps in one shot
 //   - An event is given in which case, the function will just execute one asynchronous
 //     step and will continue with the next step once it is called again by the event
 //     execution
-static void __rt_fs_try_read(void *arg)
+static int __rt_fs_try_read(void *arg)
 {
   rt_file_t *file = (rt_file_t *)arg;
-
-  int pending = 0;
   rt_event_t *event = file->step_event;
+  int pending;
+
+  RT_ASYNC_BEGIN(&file->fs->async);
 
   while (file->pending_size) {
 
+    pending = 0;
+
     int size = __rt_fs_read(
       file, file->pending_buffer, file->pending_addr, file->pending_size, &pending,
       event
@@ -398,15 +397,17 @@ static void __rt_fs_try_read(void *arg)
     file->pending_buffer += size;
     file->pending_size -= size;
 
-    if (pending && event) return;
+    if (pending) RT_ASYNC_AWAIT(&file->fs->async, event);
   }
 
   // In case there was a user event specified, enqueue it now that all
   // steps are done to notify the user
-  if (file->step_event) {
+  if (event) {
     rt_event_enqueue(file->pending_event);
     __rt_mutex_unlock(&file->fs->mutex);
   }
+
+  RT_ASYNC_END(&file->fs->async);
 }
 
 int rt_fs_read(rt_file_t *file, void *buffer, size_t size, rt_event_t *event)
@@ -429,8 +430,9 @@ int rt_fs_read(rt_file_t *file, void *buffer, size_t size, rt_event_t *event)
   // asynchronously with another event, otherwise just do everything
   // synchronously with no event
   if (event) {
-    file->step_event = __rt_init_event(&file->fs->event, event->sched, __rt_fs_try_read, (void *)file);
+    file->step_event = rt_async_init(&file->fs->async, event->sched, __rt_fs_try_read, (void *)file);
   } else {
+    rt_async_init(&file->fs->async, NULL, __rt_fs_try_read, (void *)file);
     file->step_event = NULL;
   }
 
@@ -506,3 +508,11 @@ void __rt_fs_cluster_read(rt_file_t *file, void *buffer, size_t size, rt_fs_req_
 }
 
 #endif
+
+
+
+RT_FC_BOOT_CODE void __attribute__((constructor)) __rt_fs_init()
+{
+  rt_pool_init(&__rt_fs_file_pool, RT_ALLOC_FC_DATA, sizeof(rt_file_t), 4);
+  rt_pool_init(&__rt_fs_pool, RT_ALLOC_FC_DATA, sizeof(rt_fs_t), 1);
+}
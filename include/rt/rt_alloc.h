@@ -102,6 +102,12 @@
  * the size of the previously allocated chunk when it is freed, in order to decrease the amount of metadata that is stored.
  * The allocator is using free memory to store metadata and thus the memory must be
  * directly accessible to the runtime (e.g. this should not be flash addresses).
+ *
+ * By default the allocator is a first-fit one, whose allocation and free times depend on the number of free chunks.
+ * When the runtime is compiled with __RT_ALLOC_TLSF defined, a two-level segregated fit allocator is used instead, which
+ * allocates and frees in bounded time. It rounds sizes to 16 bytes and reserves 1 bit per 16 bytes at the beginning of
+ * the managed chunk. It manages at most 16MB, the rest of a bigger chunk is not used. As the allocator structure is different,
+ * the application must also be compiled with the same definition.
  */
 
 /**@{*/
@@ -151,6 +157,21 @@ void *rt_user_alloc_align(rt_alloc_t *alloc, int size, int align);
 
 
 
+
+/** \brief Resize allocated memory.
+ *
+ * The chunk is shrunk in place by freeing its end, or grown in place if the memory just after it is free.
+ * Otherwise a new chunk is allocated, the content is copied and the previous chunk is freed.
+ * \param alloc    A pointer to the memory allocator structure, which was also given when creating the allocator.
+ * \param chunk    The memory chunk to be resized, or NULL to allocate a new one.
+ * \param old_size The current size of the memory chunk.
+ * \param new_size The new size of the memory chunk. If it is 0, the chunk is freed.
+ * \return         The resized chunk, or NULL if there was not enough memory, in which case the chunk is left unchanged.
+ */
+void *rt_user_realloc(rt_alloc_t *alloc, void *chunk, int old_size, int new_size);
+
+
+
 /** \brief Return information about the allocator state.
  *
  * This can be useful in order to take over an existing allocator if it has only 1 free chunk.
@@ -178,6 +199,80 @@ void rt_user_alloc_dump(rt_alloc_t *alloc);
 
 
 
+
+/**        
+ * @addtogroup MemAlloc
+ * @{        
+ */
+
+/**        
+ * @defgroup AllocStats Memory allocator statistics
+ *
+ * Each memory allocator keeps counters about its usage, which are always updated and cost only a few
+ * instructions per allocation and free. They give the amount of allocated memory and its peak, the
+ * number of allocations, frees and failed allocations, and the number of cycles spent in the allocator.
+ * The size of the biggest free block is computed when the statistics are retrieved.
+ *
+ * The amounts of memory take into account the rounding of the sizes done by the allocator.
+ * The cycles are only counted when the active cycles performance counter is enabled, see rt_perf_conf.
+ *
+ * All chip allocators statistics can also be dumped into a compact binary buffer, for example
+ * to report them to a host. The buffer starts with a 4-byte header containing the format version (1),
+ * the number of records and the size in bytes of a record (32). Each record contains a 1-byte memory
+ * identifier, 3 reserved bytes and the rt_alloc_stats_t structure, as 32-bit little-endian words.
+ * The memory identifier is the L2 allocator index, i.e. 0 to 2 for the L2 private bank 0, private bank 1
+ * and shared banks if they are managed separately and 0 otherwise, or 0x10 for the FC TCDM.
+ */
+
+/**@{*/
+
+/** Memory identifier of the first L2 allocator in the statistics dump. */
+#define RT_ALLOC_STATS_ID_L2      0x00
+/** Memory identifier of the FC TCDM allocator in the statistics dump. */
+#define RT_ALLOC_STATS_ID_FC_TCDM 0x10
+
+
+
+/** \brief Get the statistics of a user memory allocator.
+ *
+ * \param alloc   A pointer to the memory allocator structure.
+ * \param stats   The structure where the statistics are returned.
+ */
+void rt_user_alloc_stats(rt_alloc_t *alloc, rt_alloc_stats_t *stats);
+
+
+
+/** \brief Reset the statistics of a user memory allocator.
+ *
+ * All counters are reset to 0, except the amount of allocated memory, which is kept and is
+ * used as the new peak.
+ *
+ * \param alloc   A pointer to the memory allocator structure.
+ */
+void rt_user_alloc_stats_reset(rt_alloc_t *alloc);
+
+
+
+/** \brief Dump the statistics of all chip allocators.
+ *
+ * The statistics are written in the binary format described above.
+ * The L1 allocators are not included as they are only valid when the cluster is on. Their statistics
+ * can be retrieved with rt_user_alloc_stats on rt_alloc_l1.
+ *
+ * \param buffer  The buffer where the statistics are written, or NULL to get the needed size.
+ * \param size    The size in bytes of the buffer.
+ * \return        The number of bytes written, or needed if the buffer is NULL, or -1 if the buffer is too small.
+ */
+int rt_alloc_stats_dump(void *buffer, int size);
+
+//!@}
+
+/**        
+ * @}  
+ */
+
+
+
 /**        
  * @addtogroup MemAlloc
  * @{        
@@ -283,6 +378,21 @@ typedef enum {
 } rt_alloc_e;
 
 
+/** \enum rt_alloc_hint_e
+ * \brief Placement hint.
+ *
+ * This can be used to describe which masters will mostly access the allocated memory, so that
+ * it is placed in the L2 banks where it causes less conflicts.
+ */
+typedef enum {
+  RT_ALLOC_HINT_NONE       = 0, /*!< No hint, the memory is allocated as with rt_alloc. */
+  RT_ALLOC_HINT_FC_PRIVATE = 1, /*!< Memory mostly accessed by the fabric controller. */
+  RT_ALLOC_HINT_UDMA       = 2, /*!< Memory used for uDMA streaming. */
+  RT_ALLOC_HINT_CL_DMA     = 3, /*!< Memory used for cluster DMA transfers. */
+  RT_ALLOC_HINT_INTERLEAVE = 4, /*!< Memory accessed at the same time as another buffer, e.g. a producer and a consumer buffer. It is allocated in another bank than this buffer. */
+} rt_alloc_hint_e;
+
+
 /** \brief Allocate memory for the specified usage.
  *
  * \param flags  Specify how the memory is supposed to be used, to determine which memory allocator must be used.
@@ -310,6 +420,43 @@ void rt_free(rt_alloc_e flags, void *chunk, int size);
  */
 void *rt_alloc_align(rt_alloc_e flags, int size, int align);
 
+
+
+/** \brief Resize memory allocated for the specified usage.
+ *
+ * This is the same as rt_user_realloc but on the memory allocator corresponding to the flags.
+ * The same flags as for the allocation must be given.
+ *
+ * \param flags    Specify how the memory is supposed to be used, to determine which memory allocator must be used.
+ * \param chunk    The memory chunk to be resized, or NULL to allocate a new one.
+ * \param old_size The current size of the memory chunk.
+ * \param new_size The new size of the memory chunk. If it is 0, the chunk is freed.
+ * \return         The resized chunk, or NULL if there was not enough memory, in which case the chunk is left unchanged.
+ */
+void *rt_realloc(rt_alloc_e flags, void *chunk, int old_size, int new_size);
+
+
+
+/** \brief Allocate memory with a placement hint.
+ *
+ * When the L2 memory is managed as several banks (private bank 0, private bank 1 and shared banks), the hint
+ * is used to choose the bank where the memory is allocated first. Other banks are tried if there is not enough memory:
+ *   - RT_ALLOC_HINT_FC_PRIVATE: private bank 0, where the fabric controller data are.
+ *   - RT_ALLOC_HINT_UDMA: private bank 1, so that streaming does not disturb the fabric controller data accesses.
+ *   - RT_ALLOC_HINT_CL_DMA: shared banks, which are interleaved and thus better for cluster DMA bursts.
+ *   - RT_ALLOC_HINT_INTERLEAVE: any bank except the one of the specified buffer.
+ *
+ * The hint is ignored for other memories or when L2 is managed as a single memory, in which case this is the same as rt_alloc.
+ * The memory can be freed with rt_free.
+ *
+ * \param flags  Specify how the memory is supposed to be used, to determine which memory allocator must be used.
+ * \param size   The size in bytes of the memory to be allocated.
+ * \param hint   The placement hint.
+ * \param buffer The buffer to be interleaved with, in case the hint is RT_ALLOC_HINT_INTERLEAVE, or NULL.
+ * \return The allocated chunk or NULL if there was not enough memory available.
+ */
+void *rt_alloc_hint(rt_alloc_e flags, int size, rt_alloc_hint_e hint, void *buffer);
+
 //!@}
 
 /**        
@@ -398,6 +545,250 @@ static inline void *rt_alloc_cluster_wait(rt_alloc_req_t *req);
  */
 static inline void rt_free_cluster_wait(rt_free_req_t *req);
 
+
+
+/** \brief Allocate L1 memory from cluster side.
+ *
+ * The memory is allocated synchronously from the L1 memory of the cluster of the calling core,
+ * without going through the fabric controller. The allocator is protected by a test-and-set lock
+ * which is also taken by rt_alloc and rt_free on the fabric controller side, so that this can be called
+ * from any core of the cluster while the fabric controller is using the same allocator.
+ * Allocations with rt_alloc_cluster in the L1 memory of the calling cluster are also done this way, and
+ * the request is then already finished when the function returns.
+ * On chips without test-and-set alias in L1, the allocation is instead posted to the fabric controller and
+ * this function waits until it is done.
+ *
+ * \param size   The size in bytes of the memory to be allocated.
+ * \return       The allocated chunk or NULL if there was not enough memory available.
+ */
+void *rt_alloc_cluster_l1(int size);
+
+
+
+/** \brief Allocate aligned L1 memory from cluster side.
+ *
+ * Same as rt_alloc_cluster_l1 but with the specified alignment.
+ *
+ * \param size   The size in bytes of the memory to be allocated.
+ * \param align  The needed alignment in bytes.
+ * \return       The allocated chunk or NULL if there was not enough memory available.
+ */
+void *rt_alloc_cluster_l1_align(int size, int align);
+
+
+
+/** \brief Free L1 memory from cluster side.
+ *
+ * The memory is freed synchronously to the L1 memory of the cluster of the calling core,
+ * without going through the fabric controller.
+ *
+ * \param chunk  The chunk to be freed.
+ * \param size   The size in bytes of the memory to be freed.
+ */
+void rt_free_cluster_l1(void *chunk, int size);
+
+//!@}
+
+/**        
+ * @} 
+ */
+
+
+
+
+/**        
+ * @addtogroup MemAlloc
+ * @{        
+ */
+
+
+
+/**        
+ * @defgroup PoolMemAlloc Fixed-size object pools
+ *
+ * A pool manages objects which all have the same size. Free objects are linked together
+ * through their first word so that getting and releasing an object is done in constant time
+ * and without any metadata.
+ * Objects are never given back to the memory they were taken from, so that a pool used
+ * for objects which are often allocated and freed does not fragment this memory.
+ */
+
+
+
+/**@{*/
+
+
+/** \brief Initialize a pool.
+ *
+ * The pool is created empty. Objects are then either allocated from the memory specified by the flags
+ * when the pool is empty, or given by the caller.
+ *
+ * \param pool     A pointer to the pool structure, which must be allocated by the caller.
+ * \param flags    Specify the memory from which objects are allocated when the pool needs to grow, like for rt_alloc.
+ * \param obj_size The size in bytes of the objects. This is rounded up to 4 bytes.
+ * \param nb_grow  The number of objects allocated at once when the pool is empty. If it is 0, the pool never grows automatically.
+ */
+void rt_pool_init(rt_pool_t *pool, rt_alloc_e flags, int obj_size, int nb_grow);
+
+
+
+/** \brief Allocate objects for a pool.
+ *
+ * This allocates the specified number of objects in one chunk from the pool memory and adds them to the pool.
+ *
+ * \param pool     A pointer to the pool structure.
+ * \param nb_objects The number of objects to allocate.
+ * \return         0 if successful, -1 if there was not enough memory.
+ */
+int rt_pool_grow(rt_pool_t *pool, int nb_objects);
+
+
+
+/** \brief Give memory to a pool.
+ *
+ * The specified chunk is split into as many objects as possible, which are added to the pool.
+ * This can be used to feed the pool with memory managed by the caller.
+ *
+ * \param pool     A pointer to the pool structure.
+ * \param chunk    The memory chunk. It must be aligned on 4 bytes.
+ * \param size     The size in bytes of the memory chunk.
+ */
+void rt_pool_add(rt_pool_t *pool, void *chunk, int size);
+
+
+
+/** \brief Get an object from a pool.
+ *
+ * If the pool is empty, it first grows by the number of objects specified when the pool was initialized.
+ *
+ * \param pool     A pointer to the pool structure.
+ * \return         The object or NULL if there was none available.
+ */
+static inline void *rt_pool_alloc(rt_pool_t *pool);
+
+
+
+/** \brief Give back an object to a pool.
+ *
+ * \param pool     A pointer to the pool structure.
+ * \param obj      The object, which must have been returned by rt_pool_alloc on the same pool.
+ */
+static inline void rt_pool_free(rt_pool_t *pool, void *obj);
+
+//!@}
+
+/**        
+ * @} 
+ */
+
+
+
+
+/**        
+ * @addtogroup MemAlloc
+ * @{        
+ */
+
+
+
+/**        
+ * @defgroup ArenaMemAlloc Arena allocators
+ *
+ * An arena is a block allocated once from a memory allocator, from which buffers are then allocated
+ * by just moving a pointer. Buffers are not freed individually. Instead, the current position can
+ * be saved as a mark and everything allocated after the mark is released at once.
+ * This is useful for temporary buffers which have the same lifetime, like the tiles
+ * of a cluster kernel.
+ * The arena also keeps the highest amount of memory which was used, so that the size
+ * actually needed can be measured.
+ * The arena functions do not protect the arena against concurrent accesses.
+ */
+
+
+
+/**@{*/
+
+
+/** \brief Create an arena.
+ *
+ * The arena memory is allocated with rt_alloc for the specified usage, for example RT_ALLOC_CL_DATA+cid
+ * for the L1 memory of a cluster, so that it goes through the same protection as any other allocation.
+ *
+ * \param arena    A pointer to the arena structure, which must be allocated by the caller.
+ * \param flags    Specify which memory the arena is allocated from.
+ * \param size     The size in bytes of the arena.
+ * \return         0 if successful, -1 if there was not enough memory.
+ */
+int rt_arena_init(rt_arena_t *arena, rt_alloc_e flags, int size);
+
+
+
+/** \brief Destroy an arena.
+ *
+ * The arena memory is given back with rt_free to the memory it was allocated from.
+ *
+ * \param arena    A pointer to the arena structure.
+ */
+void rt_arena_deinit(rt_arena_t *arena);
+
+
+
+/** \brief Allocate a buffer from an arena.
+ *
+ * The buffer is aligned on 4 bytes.
+ *
+ * \param arena    A pointer to the arena structure.
+ * \param size     The size in bytes of the buffer.
+ * \return         The buffer or NULL if there was not enough memory in the arena.
+ */
+static inline void *rt_arena_alloc(rt_arena_t *arena, int size);
+
+
+
+/** \brief Allocate an aligned buffer from an arena.
+ *
+ * \param arena    A pointer to the arena structure.
+ * \param size     The size in bytes of the buffer.
+ * \param align    The needed alignment in bytes, which must be a power of 2.
+ * \return         The buffer or NULL if there was not enough memory in the arena.
+ */
+static inline void *rt_arena_alloc_align(rt_arena_t *arena, int size, int align);
+
+
+
+/** \brief Get the current position of an arena.
+ *
+ * \param arena    A pointer to the arena structure.
+ * \return         The mark, which can be given to rt_arena_release.
+ */
+static inline unsigned int rt_arena_mark(rt_arena_t *arena);
+
+
+
+/** \brief Release all buffers allocated after a mark.
+ *
+ * \param arena    A pointer to the arena structure.
+ * \param mark     A mark returned by rt_arena_mark on the same arena.
+ */
+static inline void rt_arena_release(rt_arena_t *arena, unsigned int mark);
+
+
+
+/** \brief Release all buffers of an arena.
+ *
+ * \param arena    A pointer to the arena structure.
+ */
+static inline void rt_arena_reset(rt_arena_t *arena);
+
+
+
+/** \brief Return the highest amount of memory used in an arena.
+ *
+ * \param arena    A pointer to the arena structure.
+ * \return         The highest amount of memory in bytes which has been used since the arena was created.
+ */
+static inline int rt_arena_peak(rt_arena_t *arena);
+
 //!@}
 
 /**        
@@ -479,6 +870,100 @@ static inline rt_alloc_t *rt_alloc_l2() { return NULL; }
 
 void __rt_allocs_init();
 
+static inline unsigned int __rt_alloc_stats_start()
+{
+#if defined(__riscv__) && defined(CSR_PCER_CYCLES)
+  return cpu_perf_get(CSR_PCER_CYCLES);
+#else
+  return 0;
+#endif
+}
+
+static inline void __rt_alloc_stats_alloc(rt_alloc_stats_t *stats, void *chunk, int size, unsigned int start)
+{
+  if (chunk == NULL)
+  {
+    stats->nb_fail++;
+  }
+  else
+  {
+    stats->nb_alloc++;
+    stats->used += size;
+    if (stats->used > stats->peak) stats->peak = stats->used;
+  }
+  stats->cycles += __rt_alloc_stats_start() - start;
+}
+
+static inline void __rt_alloc_stats_free(rt_alloc_stats_t *stats, int size, unsigned int start)
+{
+  stats->nb_free++;
+  stats->used -= size;
+  stats->cycles += __rt_alloc_stats_start() - start;
+}
+
+static inline void __rt_alloc_stats_resize(rt_alloc_stats_t *stats, int old_size, int new_size, unsigned int start)
+{
+  stats->used += new_size - old_size;
+  if (stats->used > stats->peak) stats->peak = stats->used;
+  stats->cycles += __rt_alloc_stats_start() - start;
+}
+
+static inline void *rt_pool_alloc(rt_pool_t *pool)
+{
+  rt_pool_obj_t *obj = pool->first_free;
+  if (unlikely(obj == NULL))
+  {
+    if (pool->nb_grow == 0 || rt_pool_grow(pool, pool->nb_grow)) return NULL;
+    obj = pool->first_free;
+  }
+  pool->first_free = obj->next;
+  pool->nb_free--;
+  return (void *)obj;
+}
+
+static inline void rt_pool_free(rt_pool_t *pool, void *_obj)
+{
+  rt_pool_obj_t *obj = (rt_pool_obj_t *)_obj;
+  obj->next = pool->first_free;
+  pool->first_free = obj;
+  pool->nb_free++;
+}
+
+static inline void *rt_arena_alloc_align(rt_arena_t *arena, int size, int align)
+{
+  unsigned int result = (arena->current + align - 1) & ~(align - 1);
+  unsigned int current = result + ((size + 3) & ~3);
+  if (unlikely(current > arena->end)) return NULL;
+  arena->current = current;
+  if (current > arena->peak) arena->peak = current;
+  return (void *)result;
+}
+
+static inline void *rt_arena_alloc(rt_arena_t *arena, int size)
+{
+  return rt_arena_alloc_align(arena, size, 4);
+}
+
+static inline unsigned int rt_arena_mark(rt_arena_t *arena)
+{
+  return arena->current;
+}
+
+static inline void rt_arena_release(rt_arena_t *arena, unsigned int mark)
+{
+  arena->current = mark;
+}
+
+static inline void rt_arena_reset(rt_arena_t *arena)
+{
+  arena->current = arena->base;
+}
+
+static inline int rt_arena_peak(rt_arena_t *arena)
+{
+  return arena->peak - arena->base;
+}
+
 
 #if defined(ARCHI_HAS_CLUSTER)
 
@@ -38,6 +38,7 @@
 #include "rt/rt_extern_alloc.h"
 #include "rt/rt_thread.h"
 #include "rt/rt_event.h"
+#include "rt/rt_async.h"
 #include "rt/rt_flash.h"
 #include "rt/rt_dev.h"
 #include "rt/rt_periph.h"
@@ -55,6 +56,7 @@
 #include "rt/rt_sccb.h"
 #include "rt/rt_dma.h"
 #include "rt/rt_sync_mc.h"
+#include "rt/rt_task.h"
 #if defined(ARCHI_HAS_CLUSTER)
 #include "rt/rt_perf.h"
 #endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* 
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __RT_RT_ASYNC_H__
+#define __RT_RT_ASYNC_H__
+
+#include "rt/rt_data.h"
+
+/**        
+ * @ingroup groupKernel        
+ */
+
+/**        
+ * @defgroup Async Continuations
+ *
+ * Continuations allow writing a sequence of asynchronous operations as a single function, without
+ * needing a thread stack. The function is executed again from the event scheduler each time an
+ * operation is over, and resumes execution where it was suspended.
+ *
+ * The function must start with RT_ASYNC_BEGIN and end with RT_ASYNC_END. After each asynchronous operation,
+ * which must be given the event returned by rt_async_init, RT_ASYNC_AWAIT suspends the function until the
+ * event is executed. If the event is NULL, the operation is considered synchronous and the function just continues,
+ * so that the same function can implement both the blocking and the asynchronous versions of an operation.
+ *
+ * As the function is entered again for each step, local variables are not kept when the function is suspended,
+ * and the state must be stored in the structure given as argument. A switch statement must not be used around
+ * RT_ASYNC_AWAIT.
+ */
+
+/**        
+ * @addtogroup Async
+ * @{        
+ */
+
+/**@{*/
+
+/** \brief Initialize a continuation.
+ *
+ * This resets the continuation so that the function is executed from the beginning next time it is called,
+ * and initializes the event which resumes it.
+ * This does not allocate any memory, so it can be called for every operation. As a consequence, on GAP the event
+ * has no peripheral data buffer and cannot be given to SPI master transfers.
+ *
+ * \param async   The continuation structure, which must be kept allocated until the continuation is over.
+ * \param sched   The scheduler where the continuation is resumed.
+ * \param entry   The function implementing the continuation. It is called with the specified argument and returns 0 or the status given to RT_ASYNC_EXIT.
+ * \param arg     The argument of the function.
+ * \return        The event which must be given to the asynchronous operations.
+ */
+static inline rt_event_t *rt_async_init(rt_async_t *async, rt_event_sched_t *sched, int (*entry)(void *), void *arg);
+
+/** \brief Tell if a continuation is over.
+ *
+ * \param async   The continuation structure.
+ * \return        1 if the continuation reached RT_ASYNC_END or RT_ASYNC_EXIT, 0 otherwise.
+ */
+static inline int rt_async_done(rt_async_t *async);
+
+/** Start the body of a continuation. */
+#define RT_ASYNC_BEGIN(async) switch ((async)->state) { case 0:
+
+/** Suspend the continuation until the event is executed, unless it is NULL. */
+#define RT_ASYNC_AWAIT(async, event)       \
+  do {                                     \
+    (async)->state = __LINE__;             \
+    if ((event) != NULL) return 0;         \
+    case __LINE__:;                        \
+  } while(0)
+
+/** Terminate the continuation with the specified status. */
+#define RT_ASYNC_EXIT(async, status)       \
+  do {                                     \
+    (async)->state = -1;                   \
+    return (status);                       \
+  } while(0)
+
+/** End the body of a continuation. */
+#define RT_ASYNC_END(async) } (async)->state = -1; return 0
+
+//!@}
+
+/**        
+ * @} end of Async group        
+ */
+
+
+
+/// @cond IMPLEM
+
+void __rt_async_resume(void *arg);
+
+static inline rt_event_t *rt_async_init(rt_async_t *async, rt_event_sched_t *sched, int (*entry)(void *), void *arg)
+{
+  async->state = 0;
+  async->entry = entry;
+  async->arg = arg;
+  return __rt_init_internal_event(&async->event, sched, __rt_async_resume, (void *)async);
+}
+
+static inline int rt_async_done(rt_async_t *async)
+{
+  return async->state == -1;
+}
+
+/// @endcond
+
+#endif
@@ -65,7 +65,7 @@
  * \param mount   Must be set to 1 for powering-up the cluster, or 0 for powering-down.
  * \param cid     The identifier of the cluster to configure. This must be an integer from 0 to the number of clusters minus 1.
  * \param flags   Flags to configure the cluster. Not currently used.
- * \param event   An event to specify how to be notified when the new cluster configuration has been applied. If NULL, the function will only return when this is done. Otherwise the event can be used to either call a callback or to wait on the event afterwards.
+ * \param event   An event to specify how to be notified when the new cluster configuration has been applied. If NULL, the function will only return when this is done. Otherwise the event can be used to either call a callback or to wait on the event afterwards. In this case, the power-up sequence is executed asynchronously from the event scheduler, so that the fabric controller can keep executing other events while the cluster is powered up.
  */
 void rt_cluster_mount(int mount, int cid, int flags, rt_event_t *event);
 
@@ -80,16 +80,16 @@ void rt_cluster_mount(int mount, int cid, int flags, rt_event_t *event);
  * for parallel computation. Thus the stacks for the other cores (called slave cores) can also be specified,
  * as well as the number of cores which can be used by the function on the cluster (including the master).
  *
- * Note that this enqueues a function execution. To allow cluster executions to be pipelined 2 can be enqueued at the same time.
- * If 2 functions are queued, as soon as the first is finished, the master core immediately continues with the next one,
+ * Note that this enqueues a function execution. To allow cluster executions to be pipelined RT_CLUSTER_CALL_DEPTH can be enqueued at the same time.
+ * If several functions are queued, as soon as the first is finished, the master core immediately continues with the next one,
  * while the fabric controller receives the termination notification and can enqueue a new execution, in order
- * to keep the cluster busy.
+ * to keep the cluster busy. If the queue is full, the calling thread is blocked until a call is started by the cluster.
  *
  * \param call    A pointer to the cluster call structure, needed by the runtime to manage the call. This is only needed if more than 2 calls are enqueued at the same time, otherwise it can be NULL.
  * \param cid     The identifier of the cluster on which to call the function.
  * \param entry   The function to be called.
  * \param arg     The argument of the function to be called.
- * \param stacks  The stacks of the cores. This must contain the master stack and one stack for each slave core. If NULL the stack will be allocated and freed automatically. The free occurs the next time that rt_cluster_call is invoked.
+ * \param stacks  The stacks of the cores. This must contain the master stack and one stack for each slave core. If NULL the stacks are taken from a region kept by the runtime for each cluster, which is reused from one call to another and only reallocated when a bigger configuration is requested. See rt_cluster_stacks_pin().
  * \param master_stack_size  Stack size of the master core which will execute the function. If stacks is NULL can be 0 to indicate to use the default master stack size. See rt_cl_master_stack_size_get().
  * \param slave_stack_size   Stack size of each core associated to the execution of the function. If stacks is NULL can be 0 to indicate to use the default slave core stack size. See rt_cl_slave_stack_size_get().
  * \param nb_pe   Number of cores involved in the execution of the function.
@@ -97,6 +97,71 @@ void rt_cluster_mount(int mount, int cid, int flags, rt_event_t *event);
  */
 int rt_cluster_call(rt_cluster_call_t *call, int cid, void (*entry)(void *arg), void *arg, void *stacks, int master_stack_size, int slave_stack_size, int nb_pe, rt_event_t *event);
 
+/** \brief Call several functions that will execute one after the other on the cluster.
+ *
+ * This enqueues all the functions at once, so that the cluster executes them back-to-back without any intervention from the
+ * fabric controller, and a single notification is sent when the last one has returned. This is intended for
+ * short functions for which the cost of a notification per function would not be negligible.
+ * All the functions are executed with the same stacks, as they are never executing at the same time.
+ * If there are more functions than free entries in the cluster call queue, the calling thread is blocked until the
+ * remaining functions can be enqueued. In the meantime it keeps executing the events of its scheduler and checks the
+ * queue every RT_CLUSTER_CALL_POLL_US microseconds.
+ *
+ * \param cid     The identifier of the cluster on which to call the functions.
+ * \param calls   The functions to be called, with their argument and number of cores. This array can be reused as soon as this function returns.
+ * \param nb_calls The number of functions to be called.
+ * \param stacks  The stacks of the cores, see rt_cluster_call().
+ * \param master_stack_size  Stack size of the master core, see rt_cluster_call().
+ * \param slave_stack_size   Stack size of each slave core, see rt_cluster_call().
+ * \param event   An event to specify how to be notified when all the functions have returned. If NULL, the function will only return when this is done. Otherwise the event can be used to either call a callback or to wait on the event afterwards.
+ * \return        0 if the functions were enqueued, -1 if the stacks could not be allocated.
+ */
+int rt_cluster_call_batch(int cid, rt_cluster_batch_t *calls, int nb_calls, void *stacks, int master_stack_size, int slave_stack_size, rt_event_t *event);
+
+/** \brief Call a function on several clusters and split the work between them.
+ *
+ * The range of items from 0 to nb_items is split into contiguous parts of nearly the same size, one for each cluster
+ * of the mask, and the function is called on each cluster with its part. The function is then executed in parallel
+ * by all the clusters, and a single notification is sent when all of them have returned.
+ * The function is executed with the default stacks of each cluster, see rt_cluster_call().
+ *
+ * \param fork    A pointer to the fork structure, needed by the runtime to manage the execution. This must be allocated by the caller and kept alive until the notification is received.
+ * \param cluster_mask The mask of clusters on which the function is called, with 1 bit per cluster, bit 0 being for cluster 0. Clusters which do not exist or whose identifier is beyond RT_CLUSTER_FORK_NB_CLUSTER are ignored.
+ * \param nb_items The number of items to split between the clusters.
+ * \param entry   The function to be called. It is given the argument and the range of items the cluster must process, from first included to last excluded.
+ * \param arg     The argument of the function to be called.
+ * \param nb_pe   Number of cores involved in the execution on each cluster. Can be 0 to indicate all the cores of the cluster.
+ * \param event   An event to specify how to be notified when all the clusters have returned. If NULL, the function will only return when this is done. Otherwise the event can be used to either call a callback or to wait on the event afterwards.
+ * \return        0 if the function was called on all the clusters. -1 if it could not be called on some of them, in which case their part of the items is not processed, while the event is still notified when the other clusters have returned.
+ */
+int rt_cluster_fork(rt_cluster_fork_t *fork, unsigned int cluster_mask, int nb_items, void (*entry)(void *arg, int first, int last), void *arg, int nb_pe, rt_event_t *event);
+
+/** \brief Pin the stack region of a cluster.
+ *
+ * The runtime keeps for each cluster a region in L1 containing the stacks of the calls for which no stack is specified.
+ * This region is sized for the biggest configuration requested so far and is reallocated when a bigger one is requested.
+ * This function can be used to allocate this region once for all, for example before allocating other buffers in L1,
+ * so that the L1 layout does not depend on the calls. Once pinned, the region is never reallocated, and a call needing more stack
+ * than what is available fails.
+ *
+ * \param cid     The identifier of the cluster.
+ * \param master_stack_size  Stack size of the master core. Can be 0 to indicate to use the default master stack size.
+ * \param slave_stack_size   Stack size of each slave core. Can be 0 to indicate to use the default slave stack size.
+ * \param nb_pe   Number of cores for which a stack is reserved. Can be 0 to indicate all the cores of the cluster.
+ * \return        0 if the region was allocated, -1 otherwise.
+ */
+int rt_cluster_stacks_pin(int cid, int master_stack_size, int slave_stack_size, int nb_pe);
+
+/** \brief Release the stack region of a cluster.
+ *
+ * This unpins the stack region and frees it. The memory is freed once the calls enqueued before are over, so this
+ * can be called while they are still pending. The next call without specified stacks allocates a new region.
+ *
+ * \param cid     The identifier of the cluster.
+ * \return        0 if the region is released, -1 otherwise.
+ */
+int rt_cluster_stacks_release(int cid);
+
 int rt_cluster_fetch_all(int cid);
 
 
@@ -182,14 +247,17 @@ extern void __rt_set_slave_stack();
 
 #if defined(PULP_CHIP_FAMILY) && (PULP_CHIP_FAMILY == CHIP_DEVCHIP || PULP_CHIP_FAMILY == CHIP_WOLFE || PULP_CHIP == CHIP_GAP)
 
-void __rt_pmu_cluster_power_up();
+// Power-up the cluster. If an event is given, this is done asynchronously and the event
+// is pushed once the cluster is on.
+void __rt_pmu_cluster_power_up(rt_event_t *event);
 
 void __rt_pmu_cluster_power_down();
   
 #else
 
-static inline void __rt_pmu_cluster_power_up()
+static inline void __rt_pmu_cluster_power_up(rt_event_t *event)
 {
+  if (event) rt_event_push(event);
 }
 
 static inline void __rt_pmu_cluster_power_down()
@@ -44,6 +44,56 @@ typedef struct rt_event_s rt_event_t;
 
 #endif
 
+// Number of event priority levels in each scheduler. Each level costs 8 bytes
+// per scheduler.
+#ifndef RT_EVENT_NB_PRIO
+#define RT_EVENT_NB_PRIO 4
+#endif
+
+// Number of thread priority levels. Each level costs 8 bytes in the ready queue.
+#ifndef RT_THREAD_NB_PRIO
+#define RT_THREAD_NB_PRIO 8
+#endif
+
+// Number of slots in the ring used by each cluster to post events to the FC.
+// Must be a power of 2.
+#ifndef RT_FC_CLUSTER_NB_EVENTS
+#define RT_FC_CLUSTER_NB_EVENTS 8
+#endif
+
+// Number of calls which can be enqueued to each cluster at the same time. Each
+// call costs 32 bytes of L1 tiny data.
+#ifndef RT_CLUSTER_CALL_DEPTH
+#define RT_CLUSTER_CALL_DEPTH 4
+#endif
+
+// Period in microseconds at which the FC checks if a slot of the cluster call
+// queue has been freed when the queue is full.
+#ifndef RT_CLUSTER_CALL_POLL_US
+#define RT_CLUSTER_CALL_POLL_US 10
+#endif
+
+// Maximum number of clusters on which a function can be forked with rt_cluster_fork.
+#ifndef RT_CLUSTER_FORK_NB_CLUSTER
+#define RT_CLUSTER_FORK_NB_CLUSTER 8
+#endif
+
+// Maximum number of cores executing tasks on a cluster
+#ifndef RT_TASK_NB_PE
+#define RT_TASK_NB_PE 8
+#endif
+
+// Number of tasks which can be queued by each core. Must be a power of 2.
+#ifndef RT_TASK_DEQUE_SIZE
+#define RT_TASK_DEQUE_SIZE 16
+#endif
+
+// Period in microseconds at which the PMU status is checked during an
+// asynchronous cluster power-up.
+#ifndef RT_PMU_POLL_US
+#define RT_PMU_POLL_US 20
+#endif
+
 /// @endcond
 
 
@@ -78,6 +128,9 @@ typedef void (*rt_error_callback_t)(void *arg, rt_event_t *event, int error, voi
 #define RT_CL_SYNC_EVENT 1
 #define PLP_RT_NOTIF_EVENT 3    // TODO this is a temp def, should be removed
 
+// This event is used to wake-up the cluster cores waiting for tasks
+#define RT_CLUSTER_TASK_EVT 4
+
 
 #ifndef LANGUAGE_ASSEMBLY
 
@@ -150,14 +203,117 @@ typedef struct rt_alloc_block_extern_s {
   unsigned int             addr;
 } rt_alloc_chunk_extern_t;
 
+typedef struct {
+  unsigned int used;
+  unsigned int peak;
+  unsigned int largest_free;
+  unsigned int nb_alloc;
+  unsigned int nb_free;
+  unsigned int nb_fail;
+  unsigned int cycles;
+} rt_alloc_stats_t;
+
+typedef struct {
+  unsigned int time;
+  unsigned int type;
+  void *object;
+  void *callback;
+} rt_event_trace_t;
+
+typedef struct {
+  int nb_free;
+  int nb_used;
+  int peak_used;
+  int nb_reserved;
+  int nb_refill;
+  int nb_exhausted;
+} rt_event_stats_t;
+
+#if defined(__RT_ALLOC_TLSF)
+
+// Free blocks are rounded to 16 bytes so that they can always hold the
+// header (size and doubly-linked list) plus the footer used for coalescing
+#ifndef RT_ALLOC_TLSF_GRANULE_LOG2
+#define RT_ALLOC_TLSF_GRANULE_LOG2 4
+#endif
+#define RT_ALLOC_TLSF_SL_LOG2      2
+#define RT_ALLOC_TLSF_SL_COUNT     (1<<RT_ALLOC_TLSF_SL_LOG2)
+#define RT_ALLOC_TLSF_FL_SHIFT     (RT_ALLOC_TLSF_SL_LOG2 + RT_ALLOC_TLSF_GRANULE_LOG2)
+// Enough first-level classes to manage up to 16MB
+#define RT_ALLOC_TLSF_FL_COUNT     (24 - RT_ALLOC_TLSF_FL_SHIFT + 1)
+// Biggest chunk which can be managed, the rest of a bigger chunk is not used
+#define RT_ALLOC_TLSF_MAX_SIZE     ((1<<24) - (1<<RT_ALLOC_TLSF_GRANULE_LOG2))
+
+typedef struct rt_alloc_tlsf_block_s {
+  int                           size;
+  struct rt_alloc_tlsf_block_s *next;
+  struct rt_alloc_tlsf_block_s *prev;
+} rt_alloc_tlsf_block_t;
+
+typedef struct {
+  unsigned int           fl_bitmap;
+  unsigned char          sl_bitmap[RT_ALLOC_TLSF_FL_COUNT];
+  rt_alloc_tlsf_block_t *heads[RT_ALLOC_TLSF_FL_COUNT][RT_ALLOC_TLSF_SL_COUNT];
+  unsigned int          *edges;
+  unsigned int           base;
+  unsigned int           end;
+  rt_alloc_stats_t       stats;
+} rt_alloc_t;
+
+#else
+
 typedef struct {
   rt_alloc_chunk_t *first_free;
+  rt_alloc_stats_t  stats;
 } rt_alloc_t;
 
+#endif
+
+#if defined(__RT_ALLOC_EXTERN_BUDDY)
+
+// Smallest block managed by the buddy allocator. A tree of 1 byte per block
+// of this size, plus the same amount for the upper levels, is allocated in L2,
+// i.e. 32KB for 8MB of external memory.
+#ifndef RT_ALLOC_EXTERN_BUDDY_MIN_LOG2
+#define RT_ALLOC_EXTERN_BUDDY_MIN_LOG2 9
+#endif
+
+typedef struct {
+  unsigned char   *tree;
+  unsigned int     base;
+  int              max_order;
+  rt_alloc_stats_t stats;
+} rt_extern_alloc_t;
+
+#else
+
 typedef struct {
   rt_alloc_chunk_extern_t *first_free;
+  rt_alloc_stats_t         stats;
 } rt_extern_alloc_t;
 
+#endif
+
+typedef struct rt_pool_obj_s {
+  struct rt_pool_obj_s *next;
+} rt_pool_obj_t;
+
+typedef struct {
+  rt_pool_obj_t *first_free;
+  int obj_size;
+  int flags;
+  int nb_grow;
+  int nb_free;
+} rt_pool_t;
+
+typedef struct {
+  int flags;
+  unsigned int base;
+  unsigned int current;
+  unsigned int end;
+  unsigned int peak;
+} rt_arena_t;
+
 
 typedef enum {
   RT_THREAD_STATE_READY,
@@ -170,14 +326,42 @@ typedef struct rt_thread_queue_s {
   struct rt_thread_s *last;
 } rt_thread_queue_t;
 
+typedef struct rt_thread_ready_queue_s {
+  rt_thread_queue_t queues[RT_THREAD_NB_PRIO];
+  unsigned int prios;
+} rt_thread_ready_queue_t;
+
+typedef struct {
+  int count;
+  rt_thread_queue_t waiting;
+} rt_sem_t;
+
+typedef struct {
+  rt_thread_queue_t waiting;
+} rt_cond_t;
+
+typedef struct {
+  char *buffer;
+  int elem_size;
+  int nb_elems;
+  int head;
+  int count;
+  rt_thread_queue_t receivers;
+  rt_thread_queue_t senders;
+} rt_msgq_t;
+
 
 
 struct rt_event_sched_s;
 
-typedef struct rt_event_sched_s {
+typedef struct rt_event_fifo_s {
   struct rt_event_s *first;
   struct rt_event_s *last;
-  struct rt_event_s *first_free;
+} rt_event_fifo_t;
+
+typedef struct rt_event_sched_s {
+  rt_event_fifo_t fifos[RT_EVENT_NB_PRIO];
+  unsigned int prios;
   struct rt_thread_s *waiting;
   rt_error_callback_t error_cb;
   void *error_arg;
@@ -224,15 +408,29 @@ typedef struct rt_event_s {
   struct rt_event_s *next;
   struct rt_event_sched_s *sched;
   struct rt_thread_s *thread;
-  int pending;
+  unsigned char pending;
+  unsigned char owned;
+  short prio;
   union {
     rt_periph_copy_t copy;
     struct {
       unsigned int data[3];
     };
+    struct {
+      struct rt_event_s *next;
+      unsigned int time;
+      unsigned int period;
+    } timer;
   };
 } rt_event_t;
 
+typedef struct rt_async_s {
+  rt_event_t event;
+  int (*entry)(void *arg);
+  void *arg;
+  int state;
+} rt_async_t;
+
 
 typedef struct rt_thread_s {
   union {
@@ -262,6 +460,9 @@ typedef struct rt_thread_s {
   struct rt_event_sched_s *sched;
   int state;
   int error;
+  int prio;
+  void *wait_data;
+  struct rt_thread_s *wait_next;
 } rt_thread_t;
 
 typedef struct rt_periph_channel_s {
@@ -288,15 +489,47 @@ typedef struct {
 typedef struct {
 } rt_cluster_call_t;
 
+typedef struct {
+  void (*entry)(void *);
+  void *arg;
+  int nb_pe;
+} rt_cluster_batch_t;
+
+typedef struct {
+  struct rt_cluster_fork_s *fork;
+  int first;
+  int last;
+} __rt_cluster_fork_range_t;
+
+typedef struct rt_cluster_fork_s {
+  void (*entry)(void *arg, int first, int last);
+  void *arg;
+  int pending;
+  rt_event_t *event;
+  __rt_cluster_fork_range_t ranges[RT_CLUSTER_FORK_NB_CLUSTER];
+} rt_cluster_fork_t;
+
 typedef struct {
   int mount_count;
   int call_head;
-  rt_event_t *events;
+  unsigned int events_head;
   void *call_stacks;
   int call_stacks_size;
   unsigned int trig_addr;
+  unsigned int events_tail;
+  rt_event_t *events[RT_FC_CLUSTER_NB_EVENTS];
+  int call_stacks_pinned;
+  void *call_stacks_retired;
+  int call_stacks_retired_size;
 } rt_fc_cluster_data_t;
 
+typedef struct {
+  rt_async_t async;
+  rt_event_t *step_event;
+  rt_event_t *event;
+  int cid;
+} __rt_cluster_mount_t;
+
 typedef struct {
   char *name;
   int channel;
@@ -366,6 +599,27 @@ typedef struct {
   unsigned int cluster_mask;
 } rt_iclock_cl_t;
 
+typedef struct {
+  void (*entry)(void *);
+  void *arg;
+} __rt_task_t;
+
+typedef struct {
+  unsigned int lock;
+  unsigned int head;
+  unsigned int tail;
+  __rt_task_t tasks[RT_TASK_DEQUE_SIZE];
+} __rt_task_deque_t;
+
+typedef struct {
+  unsigned int lock;
+  int nb_pending;
+  unsigned int sleeping;
+  int nb_pe;
+  unsigned int trig_addr;
+  __rt_task_deque_t deques[RT_TASK_NB_PE];
+} rt_task_sched_t;
+
 #if defined(CSR_PCER_NB_EVENTS)
 
 #define RT_PERF_NB_EVENTS (CSR_PCER_NB_EVENTS + 1)
@@ -428,7 +682,6 @@ typedef struct {
 typedef struct rt_fs_s {
   rt_event_t *step_event;
   rt_event_t *pending_event;
-  int mount_step;
   const char *dev_name;
   rt_flash_t *flash;
   int fs_size;
@@ -438,7 +691,7 @@ typedef struct rt_fs_s {
   unsigned char *cache;
   unsigned int  cache_addr;
   rt_mutex_t mutex;
-  rt_event_t event;
+  rt_async_t async;
 } rt_fs_t;
 
 typedef struct rt_file_s {
@@ -490,6 +743,7 @@ typedef struct rt_alloc_req_s {
   void *result;
   int flags;
   int size;
+  int align;
   rt_event_t event;
   char done;
   char cid;
@@ -562,11 +816,12 @@ extern rt_padframe_profile_t __rt_padframe_profiles[];
 #define RT_EVENT_T_ARG        4
 #define RT_EVENT_T_NEXT       8
 #define RT_EVENT_T_SCHED      12
+#define RT_EVENT_T_PRIO       22
 
 #define RT_SCHED_T_FIRST      0
 #define RT_SCHED_T_LAST       4
-#define RT_SCHED_T_FIRST_FREE 8
-#define RT_SCHED_T_WAITING    12
+#define RT_SCHED_T_PRIOS      (RT_EVENT_NB_PRIO*8)
+#define RT_SCHED_T_WAITING    (RT_EVENT_NB_PRIO*8 + 4)
 
 #define RT_PERIPH_COPY_CTRL_TYPE_BIT    0
 #define RT_PERIPH_COPY_CTRL_TYPE_WIDTH  4
@@ -617,13 +872,15 @@ extern rt_padframe_profile_t __rt_padframe_profiles[];
 #define RT_CLUSTER_CALL_T_EVENT        24
 #define RT_CLUSTER_CALL_T_SCHED        28
 
-#define RT_FC_CLUSTER_DATA_T_SIZEOF       (6*4)
+#define RT_FC_CLUSTER_DATA_T_SIZEOF       ((10+RT_FC_CLUSTER_NB_EVENTS)*4)
 #define RT_FC_CLUSTER_DATA_T_MOUNT_COUNT  0
 #define RT_FC_CLUSTER_DATA_T_CALL_HEAD    4
-#define RT_FC_CLUSTER_DATA_T_EVENTS       8
+#define RT_FC_CLUSTER_DATA_T_EVENTS_HEAD  8
 #define RT_FC_CLUSTER_DATA_T_CALL_STACKS       12
 #define RT_FC_CLUSTER_DATA_T_CALL_STACKS_SIZE  16
 #define RT_FC_CLUSTER_DATA_T_TRIG_ADDR         20
+#define RT_FC_CLUSTER_DATA_T_EVENTS_TAIL       24
+#define RT_FC_CLUSTER_DATA_T_EVENTS            28
 
 /// @endcond
 
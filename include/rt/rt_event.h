@@ -46,7 +46,12 @@
  * An event is a function callback which can be pushed to an event scheduler, for a deferred execution. 
  * All events in the same scheduler are executed in-order, in a FIFO manner.
  *
- * In order to manage several levels of event priorities, there may be several event schedulers at the same
+ * Each scheduler manages several priority levels, with one FIFO per level. When the scheduler is invoked, it
+ * always executes the events of the highest level which is not empty, so that an event with a high priority
+ * only waits for the callback being executed, whatever the number of pending events with a lower priority.
+ * The priority of an event is set with rt_event_set_prio, and is reset to the default one when the event is reserved.
+ *
+ * In order to manage several levels of event priorities, there may also be several event schedulers at the same
  * time. The application is entered with one event scheduler already created in the runtime, which is the
  * one which can be used as the default scheduler. However the application can then create multiple
  * event schedulers in order to build a more complex multi-priority scenario.
@@ -78,6 +83,14 @@
 
 /**@{*/
 
+/** The lowest event priority level, which is the default one. */
+#define RT_EVENT_PRIO_DEFAULT 0
+
+/** The highest event priority level. */
+#define RT_EVENT_PRIO_MAX     (RT_EVENT_NB_PRIO - 1)
+
+
+
 /** \brief Creates an event scheduler.
  *
  * This initialize the scheduler and makes it usable. As soon as this function is executed, events can be enqueued to the scheduler.
@@ -106,6 +119,33 @@ int rt_event_alloc(rt_event_sched_t *sched, int nb_events);
  */
 void rt_event_free(rt_event_sched_t *sched, int nb_events);
 
+/** \brief Reserve memory for events added on demand.
+ *
+ * This allocates memory for the specified number of events, which are not put in the free list immediately.
+ * Instead, each time the number of free events goes down to the low-water mark when an event is reserved,
+ * a batch of events is taken from this memory and added to the free list, until the memory is exhausted.
+ * This allows sizing the event memory from the statistics returned by rt_event_stats instead of allocating
+ * all the events up front. This can only be called once from the fabric controller.
+ *
+ * \param sched       The scheduler for which the events are intended to be used. If NULL the default scheduler for the current thread is used.
+ * \param nb_events   The maximum number of events which can be added to the free list.
+ * \param low_water   The number of free events below which a new batch is added.
+ * \param batch       The number of events added at once.
+ * \return 0 if successfull, -1 otherwise.
+ */
+int rt_event_alloc_reserve(rt_event_sched_t *sched, int nb_events, int low_water, int batch);
+
+/** \brief Get event statistics.
+ *
+ * This returns the number of events which are currently free and reserved, the peak number of
+ * reserved events, the number of events still in the memory reserved with rt_event_alloc_reserve,
+ * the number of batches added from it, and the number of times an event could not be reserved
+ * because the free list was empty.
+ *
+ * \param stats   The structure where the statistics are returned.
+ */
+void rt_event_stats(rt_event_stats_t *stats);
+
 /** \brief Reserve an event and set its callback and argument.
  *
  * This gets an event from the free list and initializes it with the specified callback.
@@ -132,6 +172,49 @@ rt_event_t *rt_event_get_blocking(rt_event_sched_t *sched);
 
 
 
+/** \brief Reserve a chain of events.
+ *
+ * This gets the specified number of events from the free list in one critical section, and initializes
+ * all of them with the same callback and argument, which can then be modified for each event.
+ * The events are linked together through their next field, the last one pointing to NULL, and can be
+ * pushed at once with rt_event_push_chain.
+ *
+ * \param sched     The scheduler for which to get the events for. If NULL the default scheduler for the current thread is used.
+ * \param nb_events The number of events to reserve.
+ * \param callback  The function which will be called when each event is executed.
+ * \param arg       The argument of the function callback.
+ * \return          The first event of the chain, or NULL if there were not enough events available, in which case no event is reserved.
+ */
+rt_event_t *rt_event_get_chain(rt_event_sched_t *sched, int nb_events, void (*callback)(void *), void *arg);
+
+
+
+/** \brief Enqueue a chain of events.
+ *
+ * This pushes all the events of the chain to their scheduler in one critical section. The events
+ * must be linked together through their next field, the last one pointing to NULL, as returned
+ * by rt_event_get_chain. They are executed in the order of the chain.
+ *
+ * \param event   The first event of the chain.
+ */
+void rt_event_push_chain(rt_event_t *event);
+
+
+
+/** \brief Set the priority of an event.
+ *
+ * This sets the priority level at which the event is executed when it is pushed to its scheduler.
+ * It can be called on an event reserved with rt_event_get before it is pushed or given to a driver.
+ * Levels go from 0 to RT_EVENT_NB_PRIO-1, the highest level being executed first. The default level
+ * is RT_EVENT_PRIO_DEFAULT.
+ *
+ * \param event   The event.
+ * \param prio    The priority level.
+ */
+static inline void rt_event_set_prio(rt_event_t *event, int prio);
+
+
+
 /** \brief Enqueue an event to a scheduler.
  *
  * This pushes the event to its scheduler, and makes it ready to be executed.
@@ -195,6 +278,71 @@ void rt_event_wait(rt_event_t *event);
 
 //!@}
 
+
+
+/**        
+ * @defgroup EventTrace Event tracing
+ *
+ * When the runtime is compiled with __RT_EVENT_TRACE defined, the event scheduler records the main steps of
+ * each event into a circular buffer in L2, at a cost of a few cycles per record, so that the time events wait
+ * in the scheduler and the time spent in callbacks can be analyzed.
+ *
+ * Each record is an rt_event_trace_t, whose type is one of the RT_EVENT_TRACE_* values. The object is the event
+ * for event records, and the new thread for thread switches. The callback is the callback of the event, if any.
+ * The time is the value of the cycle counter, which must have been activated through the performance counter API
+ * with the RT_PERF_CYCLES event.
+ *
+ * The buffer is RT_EVENT_TRACE_SIZE records long and only keeps the most recent ones.
+ * Without __RT_EVENT_TRACE, the functions are still available but there is never any record.
+ */
+
+/**        
+ * @addtogroup EventTrace
+ * @{        
+ */
+
+/**@{*/
+
+/** The event has been pushed to its scheduler. */
+#define RT_EVENT_TRACE_ENQUEUE   0
+/** The event has been removed from its scheduler for execution. */
+#define RT_EVENT_TRACE_DEQUEUE   1
+/** The callback of the event is starting. */
+#define RT_EVENT_TRACE_CB_START  2
+/** The callback of the event has returned. */
+#define RT_EVENT_TRACE_CB_END    3
+/** The scheduler switched to another thread. */
+#define RT_EVENT_TRACE_SWITCH    4
+
+/** Number of records of the trace buffer, which must be a power of 2. */
+#ifndef RT_EVENT_TRACE_SIZE
+#define RT_EVENT_TRACE_SIZE 256
+#endif
+
+/** \brief Get the trace records.
+ *
+ * This copies the valid records into the specified buffer, from the oldest to the most recent one.
+ *
+ * \param records   The buffer where the records are copied. It must be able to contain RT_EVENT_TRACE_SIZE records.
+ * \return          The number of records copied.
+ */
+int rt_event_trace_get(rt_event_trace_t *records);
+
+/** \brief Print a latency report.
+ *
+ * This analyzes the current trace records and prints, for each callback, the histograms of the time
+ * events waited in their scheduler and of the time spent in the callback, in cycles. Each histogram
+ * bucket counts the durations which have the same number of significant bits.
+ * The trace is then cleared.
+ */
+void rt_event_trace_report();
+
+//!@}
+
+/**        
+ * @} end of EventTrace group        
+ */
+
 /**        
  * @} end of Event group        
  */
@@ -208,11 +356,55 @@ void rt_event_wait(rt_event_t *event);
 
 extern RT_FC_TINY_DATA rt_event_t        *__rt_first_free;
 extern RT_FC_TINY_DATA rt_event_sched_t   __rt_sched;
+extern RT_FC_TINY_DATA rt_event_stats_t   __rt_event_stats;
+
+// Value of the pending field of a periodic event cancelled while it is in its scheduler
+// or being executed, so that it is released once executed
+#define __RT_EVENT_PENDING_CANCELLED 2
+
+// Give back a reserved event to the free list, must be called with interrupts disabled.
+// Events owned by their caller, e.g. embedded in a driver request or a continuation,
+// do not come from the free list and are left untouched
+static inline void __rt_event_release(rt_event_t *event)
+{
+  if (event->owned) return;
+  event->next = __rt_first_free;
+  __rt_first_free = event;
+  __rt_event_stats.nb_free++;
+  __rt_event_stats.nb_used--;
+}
+
+#if defined(__RT_EVENT_TRACE)
+
+extern RT_L2_DATA rt_event_trace_t __rt_event_trace_buffer[];
+extern RT_FC_TINY_DATA unsigned int __rt_event_trace_index;
+
+// Must be called with interrupts disabled
+static inline void __rt_event_trace(int type, void *object, void *callback)
+{
+  rt_event_trace_t *record = &__rt_event_trace_buffer[__rt_event_trace_index++ & (RT_EVENT_TRACE_SIZE - 1)];
+#if defined(__riscv__) && defined(CSR_PCER_CYCLES)
+  record->time = cpu_perf_get(CSR_PCER_CYCLES);
+#else
+  record->time = 0;
+#endif
+  record->type = type;
+  record->object = object;
+  record->callback = callback;
+}
+
+#else
+
+static inline void __rt_event_trace(int type, void *object, void *callback) {}
+
+#endif
 
 static inline void __rt_event_min_init(rt_event_t *event)
 {
   event->thread = NULL;
   event->pending = 0;
+  event->owned = 0;
+  event->prio = RT_EVENT_PRIO_DEFAULT;
 #if PULP_CHIP == CHIP_GAP
   event->copy.periph_data = (char *)rt_alloc(RT_ALLOC_PERIPH, RT_PERIPH_COPY_PERIPH_DATA_SIZE);
 #endif
@@ -265,12 +457,29 @@ static inline rt_event_t *__rt_wait_event_prepare(rt_event_t *event)
   event = &__rt_thread_current->event;
   event->pending = 1;
   event->callback = NULL;
+  event->prio = RT_EVENT_PRIO_DEFAULT;
   return event;
 }
 
 static inline rt_event_t *__rt_init_event(rt_event_t *event, rt_event_sched_t *sched, void (*callback)(void *), void *arg)
 {
   __rt_event_min_init(event);
+  // Such events are always embedded in a structure of the caller
+  event->owned = 1;
+  event->sched = sched;
+  event->callback = callback;
+  event->arg = arg;
+  return event;
+}
+
+// Same as __rt_init_event but without the peripheral copy buffer, for events used internally
+// by the runtime which are never given to a peripheral, e.g. kept on the stack.
+static inline rt_event_t *__rt_init_internal_event(rt_event_t *event, rt_event_sched_t *sched, void (*callback)(void *), void *arg)
+{
+  event->thread = NULL;
+  event->pending = 0;
+  event->owned = 1;
+  event->prio = RT_EVENT_PRIO_DEFAULT;
   event->sched = sched;
   event->callback = callback;
   event->arg = arg;
@@ -280,13 +489,20 @@ static inline rt_event_t *__rt_init_event(rt_event_t *event, rt_event_sched_t *s
 static inline void __rt_event_enqueue(rt_event_t *event)
 {
   rt_event_sched_t *sched = event->sched;
+  rt_event_fifo_t *fifo = &sched->fifos[event->prio];
   event->next = NULL;
-  if (sched->first) {
-    sched->last->next = event;
+  if (fifo->first) {
+    fifo->last->next = event;
   } else {
-    sched->first = event;
+    fifo->first = event;
   }
-  sched->last = event;
+  fifo->last = event;
+  sched->prios |= 1 << event->prio;
+}
+
+static inline void rt_event_set_prio(rt_event_t *event, int prio)
+{
+  event->prio = prio;
 }
 
 void __rt_event_unblock(rt_event_t *event);
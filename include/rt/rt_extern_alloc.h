@@ -40,6 +40,8 @@
 
 int rt_extern_alloc_init(rt_extern_alloc_t *a, void *_chunk, int size);
 
+void rt_extern_alloc_deinit(rt_extern_alloc_t *a);
+
 void *rt_extern_alloc(rt_extern_alloc_t *a, int size);
 
 int rt_extern_free(rt_extern_alloc_t *a, void *_chunk, int size);
@@ -50,6 +52,10 @@ void rt_extern_alloc_info(rt_extern_alloc_t *a, int *size, void **first_chunk, i
 
 void rt_extern_alloc_dump(rt_extern_alloc_t *a);
 
+void rt_extern_alloc_stats(rt_extern_alloc_t *a, rt_alloc_stats_t *stats);
+
+void rt_extern_alloc_stats_reset(rt_extern_alloc_t *a);
+
 
 /// @endcond
 
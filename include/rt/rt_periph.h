@@ -170,6 +170,8 @@ static inline rt_periph_channel_t *__rt_periph_channel(int channel) {
 
 void __rt_periph_wait_event(int event, int clear);
 
+int __rt_periph_check_event(int event, int clear);
+
 void __rt_periph_clear_event(int event);
 
 /// @endcond
@@ -160,6 +160,56 @@ void rt_iclock_unlock(rt_iclock_cl_t *lock);
 
 /// @cond IMPLEM
 
+#if defined(ARCHI_L1_TAS_BIT)
+
+// Test-and-set accesses to the cluster L1 memory. A load through the test-and-set
+// alias returns the current value and atomically sets it to -1.
+
+static inline unsigned int __rt_tas_addr(unsigned int addr) {
+  return addr | (1<<ARCHI_L1_TAS_BIT);
+}
+
+static inline int rt_tas_lock_8(unsigned int addr) {
+  __asm__ __volatile__ ("" : : : "memory");
+  int result = *(volatile unsigned char *)__rt_tas_addr(addr);
+  __asm__ __volatile__ ("" : : : "memory");
+  return result;
+}
+
+static inline void rt_tas_unlock_8(unsigned int addr, unsigned char value) {
+  __asm__ __volatile__ ("" : : : "memory");
+  *(volatile unsigned char *)addr = value;
+  __asm__ __volatile__ ("" : : : "memory");
+}
+
+static inline int rt_tas_lock_16(unsigned int addr) {
+  __asm__ __volatile__ ("" : : : "memory");
+  int result = *(volatile unsigned short *)__rt_tas_addr(addr);
+  __asm__ __volatile__ ("" : : : "memory");
+  return result;
+}
+
+static inline void rt_tas_unlock_16(unsigned int addr, unsigned short value) {
+  __asm__ __volatile__ ("" : : : "memory");
+  *(volatile unsigned short *)addr = value;
+  __asm__ __volatile__ ("" : : : "memory");
+}
+
+static inline int rt_tas_lock_32(unsigned int addr) {
+  __asm__ __volatile__ ("" : : : "memory");
+  int result = *(volatile unsigned int *)__rt_tas_addr(addr);
+  __asm__ __volatile__ ("" : : : "memory");
+  return result;
+}
+
+static inline void rt_tas_unlock_32(unsigned int addr, unsigned int value) {
+  __asm__ __volatile__ ("" : : : "memory");
+  *(volatile unsigned int *)addr = value;
+  __asm__ __volatile__ ("" : : : "memory");
+}
+
+#endif
+
 /// @endcond
 
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __RT_RT_TASK_H__
+#define __RT_RT_TASK_H__
+
+#include "rt/rt_data.h"
+
+/**        
+ * @ingroup groupCluster        
+ */
+
+/**        
+ * @defgroup Task Cluster tasks
+ *
+ * Tasks allow balancing irregular workloads between the cores of a cluster, when a static
+ * split of the work with rt_team_fork would leave some cores idle.
+ *
+ * A task is a function with an argument which is executed once by any core of the team. Each core has a queue of tasks
+ * in L1. The tasks spawned by a core are pushed to its own queue and are executed by it in reverse order,
+ * while a core which has nothing to do steals the oldest tasks of the other cores. When there is no task at all,
+ * the cores sleep on an event unit event until a task is spawned.
+ *
+ * This API can only be used from the cluster.
+ */
+
+/**        
+ * @addtogroup Task
+ * @{        
+ */
+
+/**@{*/
+
+/** \brief Execute a set of tasks on the cluster.
+ *
+ * This forks a team of cores, see rt_team_fork(), which executes the specified function as the first task, and then
+ * all the tasks spawned by it or by the other tasks. This returns once all the tasks have been executed.
+ * This must be called by the master core.
+ *
+ * \param sched     The task scheduler structure. This must be allocated by the caller in the L1 memory of the cluster and kept alive until the function returns.
+ * \param nb_cores  The number of cores executing the tasks. If it is zero, this will reuse the number of cores of the previous fork or the default.
+ * \param entry     The function executed as the first task.
+ * \param arg       The argument of the function.
+ */
+void rt_task_run(rt_task_sched_t *sched, int nb_cores, void (*entry)(void *), void *arg);
+
+/** \brief Spawn a task.
+ *
+ * The task is pushed to the queue of the calling core, and will be executed later on by this core or by another one.
+ * If the queue is full, the task is directly executed by the calling core.
+ * This can only be called from a task.
+ *
+ * \param entry     The function to be executed by the task.
+ * \param arg       The argument of the function.
+ */
+void rt_task_spawn(void (*entry)(void *), void *arg);
+
+//!@}
+
+/**        
+ * @} end of Task group        
+ */
+
+#endif
@@ -92,8 +92,174 @@ void *rt_thread_join(rt_thread_t *thread);
  */
 void rt_thread_exit(void *status);
 
+/** The lowest thread priority, which is the default one. */
+#define RT_THREAD_PRIO_DEFAULT 0
+
+/** The highest thread priority. */
+#define RT_THREAD_PRIO_MAX     (RT_THREAD_NB_PRIO - 1)
+
+/** \brief Set the priority of a thread.
+ *
+ * Only the ready threads of the highest priority are scheduled. If the priority of a ready thread becomes higher than
+ * the one of the calling thread, the calling thread is immediately preempted.
+ * Threads are created with the default priority.
+ * \param thread   The thread whose priority is modified. If NULL, the calling thread is modified.
+ * \param prio     The priority, between RT_THREAD_PRIO_DEFAULT and RT_THREAD_PRIO_MAX.
+ */
+void rt_thread_set_prio(rt_thread_t *thread, int prio);
+
+/** \brief Configure time slicing.
+ *
+ * When time slicing is enabled, the running thread is preempted at the specified period by the FC timer
+ * interrupt if another thread of the same priority is ready. A ready thread with a higher priority
+ * also preempts the running thread at this time at the latest.
+ * Time slicing is disabled by default, in which case threads of the same priority only switch when they
+ * block or yield.
+ * \param us   The time slice in microseconds, or 0 to disable time slicing.
+ */
+void rt_thread_time_slice(int us);
+
 //!@}
 
+
+
+/**        
+ * @defgroup ThreadSync Thread synchronization
+ *
+ * Semaphores, condition variables and message queues can be used to synchronize the threads of the fabric controller.
+ * When a thread is waiting, it keeps executing the events of its scheduler, and other threads can be scheduled.
+ * Resources are directly handed over to the first waiting thread, so that a waiting thread cannot be overtaken by
+ * another one, and is woken-up only once.
+ *
+ * The functions which may block must be called from threads. The other functions can also be called from event
+ * callbacks and interrupt handlers.
+ */
+
+/**        
+ * @addtogroup ThreadSync
+ * @{        
+ */
+
+/**@{*/
+
+/** \brief Initialize a counting semaphore.
+ *
+ * \param sem     The semaphore structure, which must be kept allocated as long as the semaphore is used.
+ * \param value   The initial value of the semaphore.
+ */
+void rt_sem_init(rt_sem_t *sem, int value);
+
+/** \brief Take a semaphore.
+ *
+ * This decrements the semaphore if its value is not zero. Otherwise the calling thread is blocked until
+ * the semaphore is posted.
+ * \param sem     The semaphore.
+ */
+void rt_sem_wait(rt_sem_t *sem);
+
+/** \brief Try to take a semaphore.
+ *
+ * This decrements the semaphore if its value is not zero, without blocking.
+ * \param sem     The semaphore.
+ * \return        0 if the semaphore was taken, -1 otherwise.
+ */
+int rt_sem_trywait(rt_sem_t *sem);
+
+/** \brief Post a semaphore.
+ *
+ * This wakes-up the first waiting thread if any, otherwise this increments the semaphore.
+ * \param sem     The semaphore.
+ */
+void rt_sem_post(rt_sem_t *sem);
+
+/** \brief Initialize a condition variable.
+ *
+ * As the fabric controller has a single core, the condition is protected by disabling interrupts instead of with
+ * a mutex. A thread must check the condition and wait with interrupts disabled, and they are disabled again when the thread
+ * is woken-up:
+ * \code
+ * int irq = hal_irq_disable();
+ * while (!condition) rt_cond_wait(&cond);
+ * hal_irq_restore(irq);
+ * \endcode
+ * \param cond    The condition variable structure, which must be kept allocated as long as it is used.
+ */
+void rt_cond_init(rt_cond_t *cond);
+
+/** \brief Wait on a condition variable.
+ *
+ * The calling thread is blocked until the condition variable is signaled. It must be called with interrupts disabled.
+ * \param cond    The condition variable.
+ */
+void rt_cond_wait(rt_cond_t *cond);
+
+/** \brief Signal a condition variable.
+ *
+ * This wakes-up the first thread waiting on the condition variable, if any.
+ * \param cond    The condition variable.
+ */
+void rt_cond_signal(rt_cond_t *cond);
+
+/** \brief Broadcast a condition variable.
+ *
+ * This wakes-up all the threads waiting on the condition variable.
+ * \param cond    The condition variable.
+ */
+void rt_cond_broadcast(rt_cond_t *cond);
+
+/** \brief Initialize a message queue.
+ *
+ * The queue can contain a fixed number of messages of a fixed size, which are copied into and out of the queue.
+ * Any number of threads can send and receive messages.
+ * \param msgq      The message queue structure, which must be kept allocated as long as the queue is used.
+ * \param buffer    The buffer storing the messages, which must be at least elem_size*nb_elems bytes.
+ * \param elem_size The size in bytes of each message.
+ * \param nb_elems  The maximum number of messages in the queue.
+ */
+void rt_msgq_init(rt_msgq_t *msgq, void *buffer, int elem_size, int nb_elems);
+
+/** \brief Send a message.
+ *
+ * If a thread is waiting for a message, the message is directly copied to it. Otherwise it is copied into
+ * the queue. If the queue is full, the calling thread is blocked until there is some room.
+ * \param msgq    The message queue.
+ * \param msg     The message to be copied.
+ */
+void rt_msgq_send(rt_msgq_t *msgq, const void *msg);
+
+/** \brief Try to send a message.
+ *
+ * Same as rt_msgq_send but returns an error instead of blocking if the queue is full.
+ * \param msgq    The message queue.
+ * \param msg     The message to be copied.
+ * \return        0 if the message was sent, -1 if the queue is full.
+ */
+int rt_msgq_try_send(rt_msgq_t *msgq, const void *msg);
+
+/** \brief Receive a message.
+ *
+ * This copies the oldest message of the queue, and blocks the calling thread until there is one if the queue
+ * is empty.
+ * \param msgq    The message queue.
+ * \param msg     The buffer where the message is copied.
+ */
+void rt_msgq_receive(rt_msgq_t *msgq, void *msg);
+
+/** \brief Try to receive a message.
+ *
+ * Same as rt_msgq_receive but returns an error instead of blocking if the queue is empty.
+ * \param msgq    The message queue.
+ * \param msg     The buffer where the message is copied.
+ * \return        0 if a message was received, -1 if the queue is empty.
+ */
+int rt_msgq_try_receive(rt_msgq_t *msgq, void *msg);
+
+//!@}
+
+/**        
+ * @} end of ThreadSync group        
+ */
+
 /**        
  * @} end of Threading group        
  */
@@ -102,7 +268,7 @@ void rt_thread_exit(void *status);
 
 /// @cond IMPLEM
 
-extern rt_thread_queue_t __rt_ready_queue;
+extern rt_thread_ready_queue_t __rt_ready_queue;
 
 extern rt_thread_t *__rt_thread_current;
 
@@ -114,9 +280,12 @@ void __rt_thread_sleep();
 
 void __rt_thread_set_sched(rt_thread_t *thread, rt_event_sched_t *sched);
 
+void __rt_thread_preempt();
+
 static inline void __rt_thread_enqueue_ready(rt_thread_t *thread)
 {
-  __rt_thread_enqueue(&__rt_ready_queue, thread);
+  __rt_thread_enqueue(&__rt_ready_queue.queues[thread->prio], thread);
+  __rt_ready_queue.prios |= 1 << thread->prio;
   thread->state = RT_THREAD_STATE_READY;
 }
 
@@ -131,8 +300,14 @@ static inline rt_thread_t *__rt_thread_dequeue_first(rt_thread_queue_t *queue)
 
 static inline rt_thread_t *__rt_thread_dequeue_ready()
 { 
-  rt_thread_t *thread = __rt_thread_dequeue_first(&__rt_ready_queue);
-  if (thread) thread->state = RT_THREAD_STATE_OTHER;
+  if (__rt_ready_queue.prios == 0) return NULL;
+
+  // The first thread of the highest non-empty level is scheduled
+  int prio = __FL1(__rt_ready_queue.prios);
+  rt_thread_queue_t *queue = &__rt_ready_queue.queues[prio];
+  rt_thread_t *thread = __rt_thread_dequeue_first(queue);
+  if (queue->first == NULL) __rt_ready_queue.prios &= ~(1 << prio);
+  thread->state = RT_THREAD_STATE_OTHER;
   return thread;
 }
 
@@ -67,6 +67,80 @@
  */
 unsigned long long rt_time_get_us();
 
+/** \brief Wait for some time.
+ *
+ * The calling thread is blocked for at least the specified amount of time. In the meantime
+ * the core executes the events of the scheduler of the calling thread or the other threads, and goes
+ * to sleep when there is nothing to do, until an interrupt or the end of the wait.
+ *
+ * \param us        The time to wait in microseconds.
+ */
+void rt_time_wait_us(int us);
+
+//!@}
+
+
+
+/**        
+ * @defgroup TimeEvents Delayed events
+ *
+ * Events can be pushed to their scheduler after a delay, or periodically, instead of
+ * being pushed immediately. The delayed events are kept in a timer wheel and the FC timer
+ * only raises an interrupt for the nearest deadline, so that any number of delayed events
+ * can be active without any periodic tick.
+ *
+ * The delay is rounded up to the resolution of the timer, which is clocked by the reference clock,
+ * so that an event is never executed before its deadline. Periods where the system was powered-down
+ * are not counted.
+ */
+
+/**@{*/
+
+/** \brief Push an event after a delay.
+ *
+ * The event is pushed to its scheduler once the specified amount of time has elapsed.
+ * The event must not be pushed again until it has been executed or canceled.
+ *
+ * \param event   The event to be pushed.
+ * \param us      The delay in microseconds.
+ */
+void rt_event_push_delayed(rt_event_t *event, int us);
+
+/** \brief Push an event periodically.
+ *
+ * The event is pushed to its scheduler every time the specified period has elapsed, until
+ * it is canceled with rt_event_cancel_delayed. The event is not released after its execution.
+ * If the event is still waiting in the scheduler when the next period is reached, this occurrence
+ * is dropped.
+ *
+ * \param event     The event to be pushed, which must have been reserved with rt_event_get.
+ * \param period_us The period in microseconds.
+ */
+void rt_event_push_periodic(rt_event_t *event, int period_us);
+
+/** \brief Cancel a delayed or periodic event.
+ *
+ * The event is removed from the timer and released, as if it was executed. In case of a periodic
+ * event waiting in its scheduler, its callback is not executed anymore and it is released when
+ * the scheduler reaches it. In case it is being executed, e.g. when this is called from its callback,
+ * it is released after its execution.
+ *
+ * \param event   The event to be canceled.
+ * \return        0 if the event was canceled, -1 if it was not waiting for its deadline.
+ */
+int rt_event_cancel_delayed(rt_event_t *event);
+
+/** \brief Execute events until a timeout.
+ *
+ * This invokes the specified scheduler and executes its events as they are pushed, until the
+ * specified amount of time has elapsed. When there is no event to execute, the core
+ * goes to sleep until the next interrupt or the end of the timeout, without any polling.
+ *
+ * \param sched   The scheduler to invoke. If NULL the default scheduler for the current thread is used.
+ * \param us      The timeout in microseconds.
+ */
+void rt_event_execute_timeout(rt_event_sched_t *sched, int us);
+
 //!@}
 
 /**        
@@ -43,10 +43,55 @@
 // and actually 8 to fit free chunk header size and make sure a e free block to always have
 // at least the size of the header.
 // This also requires the initial chunk to be correctly aligned.
-#define MIN_CHUNK_SIZE 8
+// It can be overridden for native builds with 64 bits pointers.
+#ifndef RT_ALLOC_MIN_CHUNK_SIZE
+#define RT_ALLOC_MIN_CHUNK_SIZE 8
+#endif
+#define MIN_CHUNK_SIZE RT_ALLOC_MIN_CHUNK_SIZE
 
 #if defined(ARCHI_HAS_L1)
 rt_alloc_t *__rt_alloc_l1;
+
+// The L1 allocator of a cluster is used both by the fabric controller and by the
+// cluster cores, so all accesses to it are protected by a test-and-set lock.
+// The lock is the first word of the cluster L1 heap, the rest is kept aligned.
+// Without test-and-set alias, the cluster cores go through the fabric controller,
+// which is then the only user and just masks interrupts.
+#define RT_ALLOC_L1_LOCK_SIZE 8
+
+static inline unsigned int __rt_alloc_l1_lock_addr(int cid)
+{
+  return (unsigned int)rt_l1_base(cid);
+}
+
+static inline void __rt_alloc_l1_lock(int cid)
+{
+#if defined(ARCHI_L1_TAS_BIT)
+  while (rt_tas_lock_32(__rt_alloc_l1_lock_addr(cid)) == -1);
+#endif
+}
+
+static inline void __rt_alloc_l1_unlock(int cid)
+{
+#if defined(ARCHI_L1_TAS_BIT)
+  rt_tas_unlock_32(__rt_alloc_l1_lock_addr(cid), 0);
+#endif
+}
+
+// Versions used from the fabric controller, which must also mask interrupts so that
+// the lock is not taken twice by an interrupt handler
+static inline int __rt_alloc_l1_lock_fc(int cid)
+{
+  int irq = hal_irq_disable();
+  __rt_alloc_l1_lock(cid);
+  return irq;
+}
+
+static inline void __rt_alloc_l1_unlock_fc(int cid, int irq)
+{
+  __rt_alloc_l1_unlock(cid);
+  hal_irq_restore(irq);
+}
 #endif
 
 #if defined(ARCHI_HAS_FC_TCDM)
@@ -67,6 +112,10 @@ rt_alloc_t __rt_alloc_l2[__RT_NB_ALLOC_L2];
   The rationnal is to get rid of the usual meta data overhead attached to traditionnal memory allocators.
 */
 
+// When the bounded-time allocator is selected, the user allocator API is
+// provided by alloc_tlsf.c and only the chip allocators are kept here
+#if !defined(__RT_ALLOC_TLSF)
+
 void rt_user_alloc_info(rt_alloc_t *a, int *_size, void **first_chunk, int *_nb_chunks)
 {
   if (first_chunk) *first_chunk = a->first_free;
@@ -104,6 +153,7 @@ void rt_user_alloc_dump(rt_alloc_t *a)
 void rt_user_alloc_init(rt_alloc_t *a, void *_chunk, int size)
 {
   rt_alloc_chunk_t *chunk = (rt_alloc_chunk_t *)ALIGN_UP((int)_chunk, MIN_CHUNK_SIZE);
+  memset((void *)&a->stats, 0, sizeof(a->stats));
   a->first_free = chunk;
   size = size - ((int)chunk - (int)_chunk);
   if (size > 0) {
@@ -112,7 +162,7 @@ void rt_user_alloc_init(rt_alloc_t *a, void *_chunk, int size)
   }
 }
 
-void *rt_user_alloc(rt_alloc_t *a, int size)
+static void *__rt_user_alloc(rt_alloc_t *a, int size)
 {
   rt_trace(RT_TRACE_ALLOC, "Allocating memory chunk (alloc: %p, size: 0x%8x)\n", a, size);
   
@@ -144,41 +194,66 @@ void *rt_user_alloc(rt_alloc_t *a, int size)
   }
 }
 
-void *rt_user_alloc_align(rt_alloc_t *a, int size, int align)
+static void *__rt_user_alloc_align(rt_alloc_t *a, int size, int align)
 {
+  // All chunks are aligned on the minimum chunk size
+  if (align <= MIN_CHUNK_SIZE) return __rt_user_alloc(a, size);
 
-  if (align < (int)sizeof(rt_alloc_chunk_t)) return rt_user_alloc(a, size);
-
-  // As the user must give back the size of the allocated chunk when freeing it, we must allocate
-  // an aligned chunk with exactly the right size
-  // To do so, we allocate a bigger chunk and we free what is before and what is after
-
-  // We reserve enough space to free the remaining room before and after the aligned chunk
-  int size_align = size + align + sizeof(rt_alloc_chunk_t) * 2;
-  unsigned int result = (unsigned int)rt_user_alloc(a, size_align);
-  if (!result) return NULL;
-
-  unsigned int result_align = (result + align - 1) & -align;
-  unsigned int headersize = result_align - result;
+  rt_alloc_chunk_t *pt = a->first_free, *prev = 0;
 
-  // In case we don't get an aligned chunk at first, we must free the room before the first aligned one
-  if (headersize != 0) {
+  size = ALIGN_UP(size, MIN_CHUNK_SIZE);
 
-    // If we don't have enough room before the aligned chunk for freeing the header, take the next aligned one
-    if (result_align - result < sizeof(rt_alloc_chunk_t)) result_align += align;
+  // Look for a free block containing an aligned chunk of the right size and carve it
+  // directly from the block. As for normal allocations, we take the end of the block, i.e.
+  // the last aligned chunk, so that the room before stays in place as a free block and the room after,
+  // if any, is smaller than the alignment.
+  // Both are multiples of the minimum chunk size as the alignment is bigger, so they can always be
+  // kept as free blocks.
+  while (pt)
+  {
+    unsigned int start = (unsigned int)pt;
+    unsigned int end = start + pt->size;
+
+    if (pt->size >= size)
+    {
+      unsigned int result = ALIGN_DOWN(end - size, align);
+      if (result >= start)
+      {
+        int tail_size = end - result - size;
+        rt_alloc_chunk_t *next = pt->next;
+
+        if (tail_size)
+        {
+          rt_alloc_chunk_t *tail = (rt_alloc_chunk_t *)(result + size);
+          tail->size = tail_size;
+          tail->next = next;
+          next = tail;
+        }
+
+        if (result != start)
+        {
+          pt->size = result - start;
+          pt->next = next;
+        }
+        else
+        {
+          if (prev) prev->next = next; else a->first_free = next;
+        }
+
+        rt_trace(RT_TRACE_ALLOC, "Allocated aligned memory chunk (alloc: %p, base: 0x%x)\n", a, result);
+        return (void *)result;
+      }
+    }
 
-    // Free the header
-    rt_user_free(a, (void *)result, headersize);
+    prev = pt;
+    pt = pt->next;
   }
 
-  // Now free what remains after
-  rt_user_free(a, (unsigned char *)(result_align + size), size_align - headersize - size);
-
-  return (void *)result_align;
+  rt_trace(RT_TRACE_ALLOC, "Not enough memory to allocate\n");
+  return NULL;
 }
 
-void __attribute__((noinline)) rt_user_free(rt_alloc_t *a, void *_chunk, int size)
-
+static void __rt_user_free(rt_alloc_t *a, void *_chunk, int size)
 {
   rt_trace(RT_TRACE_ALLOC, "Freeing memory chunk (alloc: %p, base: %p, size: 0x%8x)\n", a, _chunk, size);
   
@@ -212,10 +287,171 @@ void __attribute__((noinline)) rt_user_free(rt_alloc_t *a, void *_chunk, int siz
   }
 }
 
+void *rt_user_alloc(rt_alloc_t *a, int size)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  void *result = __rt_user_alloc(a, size);
+  __rt_alloc_stats_alloc(&a->stats, result, ALIGN_UP(size, MIN_CHUNK_SIZE), start);
+  return result;
+}
+
+void *rt_user_alloc_align(rt_alloc_t *a, int size, int align)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  void *result = __rt_user_alloc_align(a, size, align);
+  __rt_alloc_stats_alloc(&a->stats, result, ALIGN_UP(size, MIN_CHUNK_SIZE), start);
+  return result;
+}
+
+void __attribute__((noinline)) rt_user_free(rt_alloc_t *a, void *_chunk, int size)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  __rt_user_free(a, _chunk, size);
+  __rt_alloc_stats_free(&a->stats, ALIGN_UP(size, MIN_CHUNK_SIZE), start);
+}
+
+// Try to resize the chunk in place, the sizes must be already rounded
+static int __rt_user_resize(rt_alloc_t *a, void *_chunk, int old_size, int new_size)
+{
+  // Shrinking is just freeing the end of the chunk
+  if (new_size <= old_size)
+  {
+    if (new_size < old_size) __rt_user_free(a, (void *)((unsigned int)_chunk + new_size), old_size - new_size);
+    return 0;
+  }
+
+  // Otherwise look for a free block just after the chunk
+  rt_alloc_chunk_t *end = (rt_alloc_chunk_t *)((unsigned int)_chunk + old_size);
+  rt_alloc_chunk_t *pt = a->first_free, *prev = 0;
+
+  while (pt && pt < end) { prev = pt; pt = pt->next; }
+
+  int needed = new_size - old_size;
+  if (pt != end || pt->size < needed) return -1;
+
+  rt_alloc_chunk_t *next = pt->next;
+  if (pt->size != needed)
+  {
+    // The free block is moved after the grown chunk
+    rt_alloc_chunk_t *block = (rt_alloc_chunk_t *)((unsigned int)_chunk + new_size);
+    block->size = pt->size - needed;
+    block->next = next;
+    next = block;
+  }
+
+  if (prev) prev->next = next; else a->first_free = next;
+
+  return 0;
+}
+
+void *rt_user_realloc(rt_alloc_t *a, void *_chunk, int old_size, int new_size)
+{
+  if (_chunk == NULL) return rt_user_alloc(a, new_size);
+
+  if (new_size == 0)
+  {
+    rt_user_free(a, _chunk, old_size);
+    return NULL;
+  }
+
+  unsigned int start = __rt_alloc_stats_start();
+  int old_aligned = ALIGN_UP(old_size, MIN_CHUNK_SIZE);
+  int new_aligned = ALIGN_UP(new_size, MIN_CHUNK_SIZE);
+
+  if (__rt_user_resize(a, _chunk, old_aligned, new_aligned) == 0)
+  {
+    __rt_alloc_stats_resize(&a->stats, old_aligned, new_aligned, start);
+    return _chunk;
+  }
+
+  void *result = rt_user_alloc(a, new_size);
+  if (result == NULL) return NULL;
+
+  memcpy(result, _chunk, old_size);
+  rt_user_free(a, _chunk, old_size);
+
+  return result;
+}
+
+void rt_user_alloc_stats(rt_alloc_t *a, rt_alloc_stats_t *stats)
+{
+  *stats = a->stats;
+  stats->largest_free = 0;
+  for (rt_alloc_chunk_t *pt = a->first_free; pt; pt = pt->next) {
+    if ((unsigned int)pt->size > stats->largest_free) stats->largest_free = pt->size;
+  }
+}
+
+#endif
+
+void rt_user_alloc_stats_reset(rt_alloc_t *a)
+{
+  unsigned int used = a->stats.used;
+  memset((void *)&a->stats, 0, sizeof(a->stats));
+  a->stats.used = used;
+  a->stats.peak = used;
+}
+
+static int __rt_alloc_stats_dump_record(unsigned char *buffer, int id, rt_alloc_t *a)
+{
+  if (buffer)
+  {
+    buffer[0] = id;
+    buffer[1] = buffer[2] = buffer[3] = 0;
+    rt_user_alloc_stats(a, (rt_alloc_stats_t *)&buffer[4]);
+  }
+  return 4 + sizeof(rt_alloc_stats_t);
+}
+
+int rt_alloc_stats_dump(void *_buffer, int size)
+{
+  unsigned char *buffer = (unsigned char *)_buffer;
+  int nb_records = 0;
+#if defined(ARCHI_HAS_L2)
+  nb_records += __RT_NB_ALLOC_L2;
+#endif
+#if defined(ARCHI_HAS_FC_TCDM)
+  nb_records++;
+#endif
+
+  int record_size = 4 + sizeof(rt_alloc_stats_t);
+  int dump_size = 4 + nb_records * record_size;
+
+  if (buffer == NULL) return dump_size;
+  if (size < dump_size) return -1;
+
+  // The records are directly written as the buffer is aligned on 4 bytes
+  // after the header
+  buffer[0] = 1;
+  buffer[1] = nb_records;
+  buffer[2] = record_size;
+  buffer[3] = 0;
+  buffer += 4;
+
+#if defined(ARCHI_HAS_L2)
+  for (int i=0; i<__RT_NB_ALLOC_L2; i++)
+  {
+    buffer += __rt_alloc_stats_dump_record(buffer, RT_ALLOC_STATS_ID_L2 + i, &__rt_alloc_l2[i]);
+  }
+#endif
+#if defined(ARCHI_HAS_FC_TCDM)
+  buffer += __rt_alloc_stats_dump_record(buffer, RT_ALLOC_STATS_ID_FC_TCDM, &__rt_alloc_fc_tcdm);
+#endif
+
+  return dump_size;
+}
+
 void *rt_alloc(rt_alloc_e flags, int size)
 {
 #if defined(ARCHI_HAS_L1)
-  if (flags >= RT_ALLOC_CL_DATA) return rt_user_alloc(rt_alloc_l1(flags - RT_ALLOC_CL_DATA), size);
+  if (flags >= RT_ALLOC_CL_DATA)
+  {
+    int cid = flags - RT_ALLOC_CL_DATA;
+    int irq = __rt_alloc_l1_lock_fc(cid);
+    void *result = rt_user_alloc(rt_alloc_l1(cid), size);
+    __rt_alloc_l1_unlock_fc(cid, irq);
+    return result;
+  }
   else
 #endif
 #if defined(ARCHI_HAS_FC_TCDM)
@@ -237,10 +473,65 @@ void *rt_alloc(rt_alloc_e flags, int size)
   }
 }
 
+#ifdef __RT_ALLOC_L2_MULTI
+static int __rt_alloc_l2_bank(void *chunk)
+{
+  unsigned int base = (unsigned int)chunk;
+  if (base < (unsigned int)rt_l2_priv0_base() + rt_l2_priv0_size()) return 0;
+  else if (base < (unsigned int)rt_l2_priv1_base() + rt_l2_priv1_size()) return 1;
+  else return 2;
+}
+#endif
+
+void *rt_realloc(rt_alloc_e flags, void *_chunk, int old_size, int new_size)
+{
+  if (_chunk == NULL) return rt_alloc(flags, new_size);
+
+#if defined(ARCHI_HAS_L1)
+  if (flags >= RT_ALLOC_CL_DATA)
+  {
+    int cid = flags - RT_ALLOC_CL_DATA;
+    int irq = __rt_alloc_l1_lock_fc(cid);
+    void *result = rt_user_realloc(rt_alloc_l1(cid), _chunk, old_size, new_size);
+    __rt_alloc_l1_unlock_fc(cid, irq);
+    return result;
+  }
+  else
+#endif
+#if defined(ARCHI_HAS_FC_TCDM)
+  if (flags >= RT_ALLOC_FC_DATA) return rt_user_realloc(rt_alloc_fc_tcdm(), _chunk, old_size, new_size);
+  else
+#endif
+  {
+#ifdef __RT_ALLOC_L2_MULTI
+    // The chunk is first resized in its bank, and then moved to any bank
+    // if there is not enough memory there
+    void *result = rt_user_realloc(&__rt_alloc_l2[__rt_alloc_l2_bank(_chunk)], _chunk, old_size, new_size);
+    if (result == NULL && new_size > old_size)
+    {
+      result = rt_alloc(flags, new_size);
+      if (result == NULL) return NULL;
+      memcpy(result, _chunk, old_size);
+      rt_free(flags, _chunk, old_size);
+    }
+    return result;
+#else
+    return rt_user_realloc(rt_alloc_l2(), _chunk, old_size, new_size);
+#endif
+  }
+}
+
 void rt_free(rt_alloc_e flags, void *_chunk, int size)
 {
 #if defined(ARCHI_HAS_L1)
-  if (flags >= RT_ALLOC_CL_DATA) return rt_user_free(rt_alloc_l1(flags - RT_ALLOC_CL_DATA), _chunk, size);
+  if (flags >= RT_ALLOC_CL_DATA)
+  {
+    int cid = flags - RT_ALLOC_CL_DATA;
+    int irq = __rt_alloc_l1_lock_fc(cid);
+    rt_user_free(rt_alloc_l1(cid), _chunk, size);
+    __rt_alloc_l1_unlock_fc(cid, irq);
+    return;
+  }
   else
 #endif
 #if defined(ARCHI_HAS_FC_TCDM)
@@ -249,12 +540,7 @@ void rt_free(rt_alloc_e flags, void *_chunk, int size)
 #endif
   {
 #ifdef __RT_ALLOC_L2_MULTI
-    rt_alloc_t *a;
-    unsigned int base = (unsigned int)_chunk;
-    if (base < (unsigned int)rt_l2_priv0_base() + rt_l2_priv0_size()) a = &__rt_alloc_l2[0];
-    else if (base < (unsigned int)rt_l2_priv1_base() + rt_l2_priv1_size()) a = &__rt_alloc_l2[1];
-    else a = &__rt_alloc_l2[2];
-    rt_user_free(a, _chunk, size);
+    rt_user_free(&__rt_alloc_l2[__rt_alloc_l2_bank(_chunk)], _chunk, size);
 #else
     rt_user_free(rt_alloc_l2(), _chunk, size);
 #endif
@@ -264,7 +550,14 @@ void rt_free(rt_alloc_e flags, void *_chunk, int size)
 void *rt_alloc_align(rt_alloc_e flags, int size, int align)
 {
 #if defined(ARCHI_HAS_L1)
-  if (flags >= RT_ALLOC_CL_DATA) return rt_user_alloc_align(rt_alloc_l1(flags - RT_ALLOC_CL_DATA), size, align);
+  if (flags >= RT_ALLOC_CL_DATA)
+  {
+    int cid = flags - RT_ALLOC_CL_DATA;
+    int irq = __rt_alloc_l1_lock_fc(cid);
+    void *result = rt_user_alloc_align(rt_alloc_l1(cid), size, align);
+    __rt_alloc_l1_unlock_fc(cid, irq);
+    return result;
+  }
   else
 #endif
 #if defined(ARCHI_HAS_FC_TCDM)
@@ -286,20 +579,108 @@ void *rt_alloc_align(rt_alloc_e flags, int size, int align)
   } 
 }
 
+void *rt_alloc_hint(rt_alloc_e flags, int size, rt_alloc_hint_e hint, void *buffer)
+{
+#if defined(ARCHI_HAS_FC_TCDM)
+  // FC data are always allocated in the FC TCDM, like rt_alloc does, so that
+  // they can be released with rt_free. The hint only applies to L2 banks.
+  if (flags == RT_ALLOC_FC_DATA) return rt_alloc(flags, size);
+#endif
+
+#ifdef __RT_ALLOC_L2_MULTI
+  if (hint != RT_ALLOC_HINT_NONE && flags < __RT_NB_ALLOC_L2)
+  {
+    // First bank to be tried, the others are tried afterwards, starting with the next one
+    // and finishing with the first one for the interleave hint
+    int bank;
+    switch (hint)
+    {
+      case RT_ALLOC_HINT_FC_PRIVATE: bank = 0; break;
+      case RT_ALLOC_HINT_UDMA:       bank = 1; break;
+      case RT_ALLOC_HINT_CL_DMA:     bank = 2; break;
+      default:
+        bank = buffer ? __rt_alloc_l2_bank(buffer) + 1 : flags;
+        if (bank == 3) bank = 0;
+        break;
+    }
+
+    for (int i=0; i<3; i++) {
+      void *result = rt_user_alloc(&__rt_alloc_l2[bank], size);
+      if (result != NULL) return result;
+      bank++;
+      if (bank == 3) bank = 0;
+    }
+    return NULL;
+  }
+#endif
+
+  return rt_alloc(flags, size);
+}
+
+void rt_pool_init(rt_pool_t *pool, rt_alloc_e flags, int obj_size, int nb_grow)
+{
+  pool->first_free = NULL;
+  if (obj_size < (int)sizeof(rt_pool_obj_t)) obj_size = sizeof(rt_pool_obj_t);
+  pool->obj_size = ALIGN_UP(obj_size, 4);
+  pool->flags = flags;
+  pool->nb_grow = nb_grow;
+  pool->nb_free = 0;
+}
+
+void rt_pool_add(rt_pool_t *pool, void *chunk, int size)
+{
+  char *obj = (char *)chunk;
+  for (; size >= pool->obj_size; size -= pool->obj_size, obj += pool->obj_size)
+  {
+    rt_pool_free(pool, (void *)obj);
+  }
+}
+
+int rt_pool_grow(rt_pool_t *pool, int nb_objects)
+{
+  int size = pool->obj_size * nb_objects;
+  void *chunk = rt_alloc(pool->flags, size);
+  if (chunk == NULL) return -1;
+  rt_pool_add(pool, chunk, size);
+  return 0;
+}
+
+int rt_arena_init(rt_arena_t *arena, rt_alloc_e flags, int size)
+{
+  size = ALIGN_UP(size, 4);
+  void *chunk = rt_alloc(flags, size);
+  if (chunk == NULL) return -1;
+
+  arena->flags = flags;
+  arena->base = (unsigned int)chunk;
+  arena->current = arena->base;
+  arena->peak = arena->base;
+  arena->end = arena->base + size;
+
+  return 0;
+}
+
+void rt_arena_deinit(rt_arena_t *arena)
+{
+  rt_free(arena->flags, (void *)arena->base, arena->end - arena->base);
+}
+
 #if defined(ARCHI_HAS_L1)
 void __rt_alloc_init_l1(int cid)
 {
   // TODO support multu cluster
-  rt_trace(RT_TRACE_INIT, "Initializing L1 allocator (cluster: %d, base: 0x%8x, size: 0x%8x)\n", cid, (int)rt_l1_base(cid), rt_l1_size(cid));
-  rt_user_alloc_init(&__rt_alloc_l1[cid], rt_l1_base(cid), rt_l1_size(cid));
+  *(volatile unsigned int *)__rt_alloc_l1_lock_addr(cid) = 0;
+  rt_trace(RT_TRACE_INIT, "Initializing L1 allocator (cluster: %d, base: 0x%8x, size: 0x%8x)\n", cid, (int)rt_l1_base(cid) + RT_ALLOC_L1_LOCK_SIZE, rt_l1_size(cid) - RT_ALLOC_L1_LOCK_SIZE);
+  rt_user_alloc_init(&__rt_alloc_l1[cid], rt_l1_base(cid) + RT_ALLOC_L1_LOCK_SIZE, rt_l1_size(cid) - RT_ALLOC_L1_LOCK_SIZE);
 }
 
 void __rt_alloc_init_l1_for_fc(int cid)
 {
   // TODO support multu cluster
 
-  int size = sizeof(rt_alloc_t)*rt_nb_cluster();
-  __rt_alloc_l1 = (rt_alloc_t *)rt_l1_base(cid);
+  int size = sizeof(rt_alloc_t)*rt_nb_cluster() + RT_ALLOC_L1_LOCK_SIZE;
+  *(volatile unsigned int *)__rt_alloc_l1_lock_addr(cid) = 0;
+  __rt_alloc_l1 = (rt_alloc_t *)((char *)rt_l1_base(cid) + RT_ALLOC_L1_LOCK_SIZE);
 
   rt_trace(RT_TRACE_INIT, "Initializing L1 allocator (cluster: %d, base: 0x%8x, size: 0x%8x)\n", cid, (int)rt_l1_base(cid)+size, rt_l1_size(cid)-size);
   rt_user_alloc_init(&__rt_alloc_l1[cid], rt_l1_base(cid)+size, rt_l1_size(cid)-size);
@@ -350,7 +731,8 @@ void __rt_allocs_init()
 void __rt_alloc_cluster_req(void *_req)
 {
   rt_alloc_req_t *req = (rt_alloc_req_t *)_req;
-  req->result = rt_alloc(req->flags, req->size);
+  if (req->align) req->result = rt_alloc_align(req->flags, req->size, req->align);
+  else req->result = rt_alloc(req->flags, req->size);
   req->done = 1;
   __rt_cluster_notif_req_done(req->cid);
 }
@@ -363,18 +745,18 @@ void __rt_free_cluster_req(void *_req)
   __rt_cluster_notif_req_done(req->cid);
 }
 
-
-void rt_alloc_cluster(rt_alloc_e flags, int size, rt_alloc_req_t *req)
+static void __rt_alloc_cluster_post(rt_alloc_e flags, int size, int align, rt_alloc_req_t *req)
 {
   req->flags = flags;
   req->size = size;
+  req->align = align;
   req->cid = rt_cluster_id();
   req->done = 0;
   __rt_init_event(&req->event, __rt_cluster_sched_get(), __rt_alloc_cluster_req, (void *)req);
   __rt_cluster_push_fc_event(&req->event);
 }
 
-void rt_free_cluster(rt_alloc_e flags, void *chunk, int size, rt_free_req_t *req)
+static void __rt_free_cluster_post(rt_alloc_e flags, void *chunk, int size, rt_free_req_t *req)
 {
   req->flags = flags;
   req->size = size;
@@ -386,4 +768,100 @@ void rt_free_cluster(rt_alloc_e flags, void *chunk, int size, rt_free_req_t *req
 }
 
 
+#if defined(ARCHI_HAS_L1)
+
+#if defined(ARCHI_L1_TAS_BIT)
+
+// The L1 allocator of a cluster is directly used by its cores. It is protected by
+// the same lock as the one taken by the fabric controller, which is much cheaper
+// than posting a request to the fabric controller.
+
+void *rt_alloc_cluster_l1(int size)
+{
+  int cid = rt_cluster_id();
+  __rt_alloc_l1_lock(cid);
+  void *result = rt_user_alloc(rt_alloc_l1(cid), size);
+  __rt_alloc_l1_unlock(cid);
+  return result;
+}
+
+void *rt_alloc_cluster_l1_align(int size, int align)
+{
+  int cid = rt_cluster_id();
+  __rt_alloc_l1_lock(cid);
+  void *result = rt_user_alloc_align(rt_alloc_l1(cid), size, align);
+  __rt_alloc_l1_unlock(cid);
+  return result;
+}
+
+void rt_free_cluster_l1(void *chunk, int size)
+{
+  int cid = rt_cluster_id();
+  __rt_alloc_l1_lock(cid);
+  rt_user_free(rt_alloc_l1(cid), chunk, size);
+  __rt_alloc_l1_unlock(cid);
+}
+
+#else
+
+// Without test-and-set alias, the L1 allocator can not be safely shared between the
+// fabric controller and the cluster cores, so the requests are still posted to the
+// fabric controller, which is then the only one using it.
+
+void *rt_alloc_cluster_l1(int size)
+{
+  rt_alloc_req_t req;
+  __rt_alloc_cluster_post(RT_ALLOC_CL_DATA + rt_cluster_id(), size, 0, &req);
+  return rt_alloc_cluster_wait(&req);
+}
+
+void *rt_alloc_cluster_l1_align(int size, int align)
+{
+  rt_alloc_req_t req;
+  __rt_alloc_cluster_post(RT_ALLOC_CL_DATA + rt_cluster_id(), size, align, &req);
+  return rt_alloc_cluster_wait(&req);
+}
+
+void rt_free_cluster_l1(void *chunk, int size)
+{
+  rt_free_req_t req;
+  __rt_free_cluster_post(RT_ALLOC_CL_DATA + rt_cluster_id(), chunk, size, &req);
+  rt_free_cluster_wait(&req);
+}
+
+#endif
+
+#endif
+
+void rt_alloc_cluster(rt_alloc_e flags, int size, rt_alloc_req_t *req)
+{
+#if defined(ARCHI_HAS_L1) && defined(ARCHI_L1_TAS_BIT)
+  // Local L1 allocations are done synchronously, only other memories need
+  // to go through the fabric controller
+  if (flags == RT_ALLOC_CL_DATA + rt_cluster_id())
+  {
+    req->result = rt_alloc_cluster_l1(size);
+    req->done = 1;
+    return;
+  }
+#endif
+
+  __rt_alloc_cluster_post(flags, size, 0, req);
+}
+
+void rt_free_cluster(rt_alloc_e flags, void *chunk, int size, rt_free_req_t *req)
+{
+#if defined(ARCHI_HAS_L1) && defined(ARCHI_L1_TAS_BIT)
+  if (flags == RT_ALLOC_CL_DATA + rt_cluster_id())
+  {
+    rt_free_cluster_l1(chunk, size);
+    req->done = 1;
+    return;
+  }
+#endif
+
+  __rt_free_cluster_post(flags, chunk, size, req);
+}
+
+
 #endif
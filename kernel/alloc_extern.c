@@ -39,6 +39,10 @@
 #include <string.h>
 #include <stdio.h>
 
+// When the buddy allocator is selected, the external allocator API is provided
+// by alloc_extern_buddy.c
+#if !defined(__RT_ALLOC_EXTERN_BUDDY)
+
 // Allocate at least 4 bytes to avoid misaligned accesses when parsing free blocks 
 // and actually 8 to fit free chunk header size and make sure a e free block to always have
 // at least the size of the header.
@@ -103,6 +107,8 @@ void rt_extern_alloc_dump(rt_extern_alloc_t *a)
 int rt_extern_alloc_init(rt_extern_alloc_t *a, void *addr, int size)
 {
   unsigned int start_addr = ALIGN_UP((int)addr, MIN_CHUNK_SIZE);
+  a->first_free = NULL;
+  memset((void *)&a->stats, 0, sizeof(a->stats));
   rt_alloc_chunk_extern_t *chunk = __rt_alloc_chunk();
   if (chunk == NULL) return -1;
   size = size - (start_addr - (unsigned int)addr);
@@ -115,7 +121,19 @@ int rt_extern_alloc_init(rt_extern_alloc_t *a, void *addr, int size)
   return 0;
 }
 
-void *rt_extern_alloc(rt_extern_alloc_t *a, int size)
+void rt_extern_alloc_deinit(rt_extern_alloc_t *a)
+{
+  rt_alloc_chunk_extern_t *pt = a->first_free;
+  while (pt)
+  {
+    rt_alloc_chunk_extern_t *next = pt->next;
+    __rt_free_chunk(pt);
+    pt = next;
+  }
+  a->first_free = NULL;
+}
+
+static void *__rt_extern_alloc(rt_extern_alloc_t *a, int size)
 {
   rt_alloc_chunk_extern_t *pt = a->first_free, *prev = 0;
 
@@ -144,41 +162,70 @@ void *rt_extern_alloc(rt_extern_alloc_t *a, int size)
   }
 }
 
-void *rt_extern_alloc_align(rt_extern_alloc_t *a, int size, int align)
+static void *__rt_extern_alloc_align(rt_extern_alloc_t *a, int size, int align)
 {
+  if (align <= MIN_CHUNK_SIZE) return __rt_extern_alloc(a, size);
 
-  if (align < (int)sizeof(rt_alloc_chunk_extern_t)) return rt_extern_alloc(a, size);
-
-  // As the user must give back the size of the allocated chunk when freeing it, we must allocate
-  // an aligned chunk with exactly the right size
-  // To do so, we allocate a bigger chunk and we free what is before and what is after
-
-  // We reserve enough space to free the remaining room before and after the aligned chunk
-  int size_align = size + align + sizeof(rt_alloc_chunk_extern_t) * 2;
-  unsigned int result = (unsigned int)rt_extern_alloc(a, size_align);
-  if (!result) return NULL;
-
-  unsigned int result_align = (result + align - 1) & -align;
-  unsigned int headersize = result_align - result;
+  rt_alloc_chunk_extern_t *pt = a->first_free, *prev = 0;
 
-  // In case we don't get an aligned chunk at first, we must free the room before the first aligned one
-  if (headersize != 0) {
+  size = ALIGN_UP(size, MIN_CHUNK_SIZE);
 
-    // If we don't have enough room before the aligned chunk for freeing the header, take the next aligned one
-    if (result_align - result < sizeof(rt_alloc_chunk_extern_t)) result_align += align;
+  // Same as for the user allocator, the last aligned chunk of the first free block
+  // big enough is carved in place
+  while (pt)
+  {
+    unsigned int start = pt->addr;
+    unsigned int end = start + pt->size;
+
+    if (pt->size >= size)
+    {
+      unsigned int result = ALIGN_DOWN(end - size, align);
+      if (result >= start)
+      {
+        int tail_size = end - result - size;
+        rt_alloc_chunk_extern_t *next = pt->next;
+
+        if (result != start)
+        {
+          if (tail_size)
+          {
+            rt_alloc_chunk_extern_t *tail = __rt_alloc_chunk();
+            if (tail == NULL) return NULL;
+            tail->addr = result + size;
+            tail->size = tail_size;
+            tail->next = next;
+            next = tail;
+          }
+          pt->size = result - start;
+          pt->next = next;
+        }
+        else
+        {
+          // The descriptor of the free block is reused for the room after
+          if (tail_size)
+          {
+            pt->addr = result + size;
+            pt->size = tail_size;
+          }
+          else
+          {
+            if (prev) prev->next = next; else a->first_free = next;
+            __rt_free_chunk(pt);
+          }
+        }
+
+        return (void *)result;
+      }
+    }
 
-    // Free the header
-    rt_extern_free(a, (void *)result, headersize);
+    prev = pt;
+    pt = pt->next;
   }
 
-  // Now free what remains after
-  rt_extern_free(a, (unsigned char *)(result_align + size), size_align - headersize - size);
-
-  return (void *)result_align;
+  return NULL;
 }
 
-int __attribute__((noinline)) rt_extern_free(rt_extern_alloc_t *a, void *addr, int size)
-
+static int __rt_extern_free(rt_extern_alloc_t *a, void *addr, int size)
 {
 
 
@@ -190,7 +237,7 @@ int __attribute__((noinline)) rt_extern_free(rt_extern_alloc_t *a, void *addr, i
     prev = next; next = next->next; 
   }
 
-  if (((char *)addr + size) == (char *)next->addr) {
+  if (next && ((char *)addr + size) == (char *)next->addr) {
     /* Coalesce with next */
     next->size = size + next->size;
     next->addr = (unsigned int)addr;
@@ -217,3 +264,46 @@ int __attribute__((noinline)) rt_extern_free(rt_extern_alloc_t *a, void *addr, i
   }
   return 0;
 }
+
+void *rt_extern_alloc(rt_extern_alloc_t *a, int size)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  void *result = __rt_extern_alloc(a, size);
+  __rt_alloc_stats_alloc(&a->stats, result, ALIGN_UP(size, MIN_CHUNK_SIZE), start);
+  return result;
+}
+
+void *rt_extern_alloc_align(rt_extern_alloc_t *a, int size, int align)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  void *result = __rt_extern_alloc_align(a, size, align);
+  __rt_alloc_stats_alloc(&a->stats, result, ALIGN_UP(size, MIN_CHUNK_SIZE), start);
+  return result;
+}
+
+int __attribute__((noinline)) rt_extern_free(rt_extern_alloc_t *a, void *addr, int size)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  int err = __rt_extern_free(a, addr, size);
+  if (err == 0) __rt_alloc_stats_free(&a->stats, ALIGN_UP(size, MIN_CHUNK_SIZE), start);
+  return err;
+}
+
+void rt_extern_alloc_stats(rt_extern_alloc_t *a, rt_alloc_stats_t *stats)
+{
+  *stats = a->stats;
+  stats->largest_free = 0;
+  for (rt_alloc_chunk_extern_t *pt = a->first_free; pt; pt = pt->next) {
+    if ((unsigned int)pt->size > stats->largest_free) stats->largest_free = pt->size;
+  }
+}
+
+void rt_extern_alloc_stats_reset(rt_extern_alloc_t *a)
+{
+  unsigned int used = a->stats.used;
+  memset((void *)&a->stats, 0, sizeof(a->stats));
+  a->stats.used = used;
+  a->stats.peak = used;
+}
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "rt/rt_api.h"
+#include <string.h>
+#include <stdio.h>
+
+#if defined(__RT_ALLOC_EXTERN_BUDDY)
+
+/*
+  Buddy variant of the external memory allocator. As the external memory cannot
+  be directly accessed, all metadata are kept in L2 in a complete binary tree
+  with one byte per node. The root covers the whole memory and each level splits
+  the blocks of the upper level in 2, down to the minimum block size.
+
+  Each node contains the order of the biggest free block in its sub-tree, plus 1,
+  0 meaning that nothing is free. A block of order n is 2^n minimum blocks.
+  Allocating and freeing are just a walk from the root to one node, or the
+  opposite, so they take a time proportional to the tree depth.
+
+  The size is rounded to the next power of 2 number of blocks, so the same size must be
+  given back when the chunk is freed, as for the other allocators.
+*/
+
+#define MIN_LOG2  RT_ALLOC_EXTERN_BUDDY_MIN_LOG2
+#define MIN_SIZE  (1<<MIN_LOG2)
+
+#define ALIGN_UP(addr,size)   (((addr) + (size) - 1) & ~((size) - 1))
+
+#define Max(x, y) (((x)>(y))?(x):(y))
+
+static inline int __rt_buddy_order(int size)
+{
+  int nb_blocks = (size + MIN_SIZE - 1) >> MIN_LOG2;
+  if (nb_blocks <= 1) return 0;
+  return __FL1(nb_blocks - 1) + 1;
+}
+
+static inline int __rt_buddy_tree_size(rt_extern_alloc_t *a)
+{
+  return (2 << a->max_order) - 1;
+}
+
+// Recompute the value of a node from its children, whose order is one less
+static inline void __rt_buddy_update(rt_extern_alloc_t *a, int node, int order)
+{
+  int left = a->tree[node*2+1];
+  int right = a->tree[node*2+2];
+  if (left == order && right == order) a->tree[node] = order + 1;
+  else a->tree[node] = Max(left, right);
+}
+
+static void __rt_buddy_update_parents(rt_extern_alloc_t *a, int node, int order)
+{
+  while (node)
+  {
+    node = (node - 1) >> 1;
+    order++;
+    __rt_buddy_update(a, node, order);
+  }
+}
+
+static void __rt_buddy_info(rt_extern_alloc_t *a, int node, int order, unsigned int addr, int *size, int *nb_chunks, void **first_chunk, int dump)
+{
+  int value = a->tree[node];
+  if (value == 0) return;
+
+  if (value == order + 1)
+  {
+    if (first_chunk && *first_chunk == NULL) *first_chunk = (void *)addr;
+    *size += MIN_SIZE << order;
+    (*nb_chunks)++;
+    if (dump) printf("Free Block at %8X, size: %8x, Order: %d\n", addr, MIN_SIZE << order, order);
+    return;
+  }
+
+  __rt_buddy_info(a, node*2+1, order-1, addr, size, nb_chunks, first_chunk, dump);
+  __rt_buddy_info(a, node*2+2, order-1, addr + (MIN_SIZE << (order-1)), size, nb_chunks, first_chunk, dump);
+}
+
+void rt_extern_alloc_info(rt_extern_alloc_t *a, int *_size, void **first_chunk, int *_nb_chunks)
+{
+  int size = 0;
+  int nb_chunks = 0;
+
+  if (first_chunk) *first_chunk = NULL;
+
+  if (a->tree) __rt_buddy_info(a, 0, a->max_order, a->base, &size, &nb_chunks, first_chunk, 0);
+
+  if (_size) *_size = size;
+  if (_nb_chunks) *_nb_chunks = nb_chunks;
+}
+
+void rt_extern_alloc_dump(rt_extern_alloc_t *a)
+{
+  int size = 0;
+  int nb_chunks = 0;
+
+  printf("======== Memory allocator state: ============\n");
+  if (a->tree) __rt_buddy_info(a, 0, a->max_order, a->base, &size, &nb_chunks, NULL, 1);
+  printf("=============================================\n");
+}
+
+int rt_extern_alloc_init(rt_extern_alloc_t *a, void *addr, int size)
+{
+  unsigned int base = ALIGN_UP((unsigned int)addr, MIN_SIZE);
+  int nb_blocks = (size - (int)(base - (unsigned int)addr)) >> MIN_LOG2;
+
+  a->tree = NULL;
+  a->base = base;
+  a->max_order = 0;
+  memset((void *)&a->stats, 0, sizeof(a->stats));
+
+  if (nb_blocks <= 0) return 0;
+
+  a->max_order = __rt_buddy_order(nb_blocks << MIN_LOG2);
+
+  // The tree is kept in L2 as it can be quite big for the FC memory
+  a->tree = rt_alloc(RT_ALLOC_PERIPH, __rt_buddy_tree_size(a));
+  if (a->tree == NULL) return -1;
+
+  // The tree always covers a power of 2 number of blocks, the blocks above
+  // the memory size are just never marked free
+  int first_leaf = (1 << a->max_order) - 1;
+  for (int i=0; i<(1 << a->max_order); i++)
+  {
+    a->tree[first_leaf + i] = i < nb_blocks;
+  }
+
+  for (int order=1; order<=a->max_order; order++)
+  {
+    int first = (1 << (a->max_order - order)) - 1;
+    for (int i=0; i<(1 << (a->max_order - order)); i++)
+    {
+      __rt_buddy_update(a, first + i, order);
+    }
+  }
+
+  return 0;
+}
+
+void rt_extern_alloc_deinit(rt_extern_alloc_t *a)
+{
+  if (a->tree)
+  {
+    rt_free(RT_ALLOC_PERIPH, a->tree, __rt_buddy_tree_size(a));
+    a->tree = NULL;
+  }
+}
+
+// Allocate a block of the specified order from a free block of the alignment order,
+// which is always the first sub-block of the aligned block
+static void *__rt_buddy_alloc(rt_extern_alloc_t *a, int order, int align_order)
+{
+  int max_order = Max(order, align_order);
+
+  if (a->tree == NULL || max_order > a->max_order || a->tree[0] < max_order + 1) return NULL;
+
+  int node = 0;
+  unsigned int addr = a->base;
+  int node_order = a->max_order;
+
+  // Blocks are taken from the end of the memory first, as for the list allocator,
+  // so that the first address, which can be 0 for external memories, is only
+  // returned when nothing else is available. Below the alignment order, the
+  // first sub-block is taken to get an aligned address.
+  while (node_order > order)
+  {
+    int aligned = node_order <= max_order;
+    int needed = (aligned ? order : max_order) + 1;
+    node_order--;
+    if (!aligned && a->tree[node*2+2] >= needed)
+    {
+      node = node*2+2;
+      addr += MIN_SIZE << node_order;
+    }
+    else if (a->tree[node*2+1] >= needed)
+    {
+      node = node*2+1;
+    }
+    else
+    {
+      node = node*2+2;
+      addr += MIN_SIZE << node_order;
+    }
+  }
+
+  a->tree[node] = 0;
+  __rt_buddy_update_parents(a, node, order);
+
+  return (void *)addr;
+}
+
+void *rt_extern_alloc(rt_extern_alloc_t *a, int size)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  int order = __rt_buddy_order(size);
+  void *result = __rt_buddy_alloc(a, order, 0);
+  __rt_alloc_stats_alloc(&a->stats, result, MIN_SIZE << order, start);
+  return result;
+}
+
+void *rt_extern_alloc_align(rt_extern_alloc_t *a, int size, int align)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  int order = __rt_buddy_order(size);
+  // Blocks are naturally aligned on their size from the base, which is
+  // aligned on the minimum block size
+  void *result = __rt_buddy_alloc(a, order, __rt_buddy_order(align));
+  __rt_alloc_stats_alloc(&a->stats, result, MIN_SIZE << order, start);
+  return result;
+}
+
+int rt_extern_free(rt_extern_alloc_t *a, void *addr, int size)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  int order = __rt_buddy_order(size);
+  int index = ((unsigned int)addr - a->base) >> (MIN_LOG2 + order);
+  int node = (1 << (a->max_order - order)) - 1 + index;
+
+  a->tree[node] = order + 1;
+  __rt_buddy_update_parents(a, node, order);
+
+  __rt_alloc_stats_free(&a->stats, MIN_SIZE << order, start);
+
+  return 0;
+}
+
+void rt_extern_alloc_stats(rt_extern_alloc_t *a, rt_alloc_stats_t *stats)
+{
+  *stats = a->stats;
+  stats->largest_free = a->tree && a->tree[0] ? MIN_SIZE << (a->tree[0] - 1) : 0;
+}
+
+void rt_extern_alloc_stats_reset(rt_extern_alloc_t *a)
+{
+  unsigned int used = a->stats.used;
+  memset((void *)&a->stats, 0, sizeof(a->stats));
+  a->stats.used = used;
+  a->stats.peak = used;
+}
+
+#endif
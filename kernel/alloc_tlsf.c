@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "rt/rt_api.h"
+#include <string.h>
+#include <stdio.h>
+
+#if defined(__RT_ALLOC_TLSF)
+
+/*
+  Bounded-time variant of the user allocator, based on two-level segregated fit.
+  It keeps the same contract as the first-fit allocator, i.e. the size is given back
+  when a chunk is freed, so that there is no header in allocated chunks.
+
+  Free blocks are kept in one doubly-linked list per size class. The first level
+  splits sizes by power of 2 and the second level linearly splits each power of 2.
+  One bitmap per level gives the non-empty lists so that a fitting class is found
+  with 2 find-first-one.
+
+  As allocated chunks do not have any header, neighbour free blocks are found for
+  coalescing through a bitmap, reserved at the beginning of the managed memory, where
+  a bit is set for the first and the last granule of each free block. The last word
+  of each free block contains its size so that a previous free block can be reached
+  from its end.
+*/
+
+#define GRANULE_LOG2 RT_ALLOC_TLSF_GRANULE_LOG2
+#define GRANULE      (1<<GRANULE_LOG2)
+#define SL_LOG2      RT_ALLOC_TLSF_SL_LOG2
+#define SL_COUNT     RT_ALLOC_TLSF_SL_COUNT
+#define FL_SHIFT     RT_ALLOC_TLSF_FL_SHIFT
+#define FL_COUNT     RT_ALLOC_TLSF_FL_COUNT
+
+#define ALIGN_UP(addr,size)   (((addr) + (size) - 1) & ~((size) - 1))
+#define ALIGN_DOWN(addr,size) ((addr) & ~((size) - 1))
+
+static inline void __rt_tlsf_mapping(int size, int *fl, int *sl)
+{
+  if (size < (1<<FL_SHIFT)) {
+    *fl = 0;
+    *sl = size >> GRANULE_LOG2;
+  } else {
+    int log2 = __FL1(size);
+    *fl = log2 - FL_SHIFT + 1;
+    *sl = (size >> (log2 - SL_LOG2)) - SL_COUNT;
+  }
+}
+
+// Round the size up to the next class so that any block of the found class
+// is big enough
+static inline int __rt_tlsf_round(int size)
+{
+  if (size >= (1<<FL_SHIFT)) size += (1 << (__FL1(size) - SL_LOG2)) - 1;
+  return size;
+}
+
+static inline int __rt_tlsf_edge_get(rt_alloc_t *a, unsigned int addr)
+{
+  unsigned int index = (addr - a->base) >> GRANULE_LOG2;
+  return (a->edges[index >> 5] >> (index & 0x1f)) & 1;
+}
+
+static inline void __rt_tlsf_edge_set(rt_alloc_t *a, unsigned int addr, int value)
+{
+  unsigned int index = (addr - a->base) >> GRANULE_LOG2;
+  if (value) a->edges[index >> 5] |= 1 << (index & 0x1f);
+  else a->edges[index >> 5] &= ~(1 << (index & 0x1f));
+}
+
+static inline void __rt_tlsf_edges_set(rt_alloc_t *a, rt_alloc_tlsf_block_t *block, int size, int value)
+{
+  __rt_tlsf_edge_set(a, (unsigned int)block, value);
+  __rt_tlsf_edge_set(a, (unsigned int)block + size - GRANULE, value);
+}
+
+static void __rt_tlsf_insert(rt_alloc_t *a, rt_alloc_tlsf_block_t *block, int size)
+{
+  int fl, sl;
+  __rt_tlsf_mapping(size, &fl, &sl);
+
+  rt_alloc_tlsf_block_t *head = a->heads[fl][sl];
+  block->size = size;
+  block->prev = NULL;
+  block->next = head;
+  if (head) head->prev = block;
+  a->heads[fl][sl] = block;
+  *(int *)((unsigned int)block + size - 4) = size;
+
+  a->fl_bitmap |= 1 << fl;
+  a->sl_bitmap[fl] |= 1 << sl;
+
+  __rt_tlsf_edges_set(a, block, size, 1);
+}
+
+static void __rt_tlsf_remove(rt_alloc_t *a, rt_alloc_tlsf_block_t *block)
+{
+  int fl, sl;
+  __rt_tlsf_mapping(block->size, &fl, &sl);
+
+  if (block->next) block->next->prev = block->prev;
+  if (block->prev) {
+    block->prev->next = block->next;
+  } else {
+    a->heads[fl][sl] = block->next;
+    if (block->next == NULL) {
+      a->sl_bitmap[fl] &= ~(1 << sl);
+      if (a->sl_bitmap[fl] == 0) a->fl_bitmap &= ~(1 << fl);
+    }
+  }
+
+  __rt_tlsf_edges_set(a, block, block->size, 0);
+}
+
+// Return the first block of a class able to contain the specified size,
+// which must be already rounded to the next class
+static rt_alloc_tlsf_block_t *__rt_tlsf_find(rt_alloc_t *a, int size)
+{
+  int fl, sl;
+  __rt_tlsf_mapping(size, &fl, &sl);
+  if (fl >= FL_COUNT) return NULL;
+
+  unsigned int sl_map = a->sl_bitmap[fl] & (~0U << sl);
+  if (sl_map == 0) {
+    unsigned int fl_map = a->fl_bitmap & (~0U << (fl + 1));
+    if (fl_map == 0) return NULL;
+    fl = __FF1(fl_map);
+    sl_map = a->sl_bitmap[fl];
+  }
+
+  return a->heads[fl][__FF1(sl_map)];
+}
+
+void rt_user_alloc_info(rt_alloc_t *a, int *_size, void **first_chunk, int *_nb_chunks)
+{
+  int size = 0;
+  int nb_chunks = 0;
+
+  if (first_chunk) *first_chunk = NULL;
+
+  for (int fl=0; fl<FL_COUNT; fl++) {
+    for (int sl=0; sl<SL_COUNT; sl++) {
+      for (rt_alloc_tlsf_block_t *pt = a->heads[fl][sl]; pt; pt = pt->next) {
+        if (first_chunk && *first_chunk == NULL) *first_chunk = (void *)pt;
+        size += pt->size;
+        nb_chunks++;
+      }
+    }
+  }
+
+  if (_size) *_size = size;
+  if (_nb_chunks) *_nb_chunks = nb_chunks;
+}
+
+void rt_user_alloc_dump(rt_alloc_t *a)
+{
+  printf("======== Memory allocator state: ============\n");
+  for (int fl=0; fl<FL_COUNT; fl++) {
+    for (int sl=0; sl<SL_COUNT; sl++) {
+      for (rt_alloc_tlsf_block_t *pt = a->heads[fl][sl]; pt; pt = pt->next) {
+        printf("Free Block at %8X, size: %8x, Class: %d/%d, Next: %8X ", (unsigned int) pt, pt->size, fl, sl, (unsigned int) pt->next);
+        if (pt == pt->next) {
+          printf(" CORRUPTED\n"); break;
+        } else printf("\n");
+      }
+    }
+  }
+  printf("=============================================\n");
+}
+
+void rt_user_alloc_init(rt_alloc_t *a, void *_chunk, int size)
+{
+  unsigned int chunk = ALIGN_UP((unsigned int)_chunk, GRANULE);
+  size = ALIGN_DOWN(size - (int)(chunk - (unsigned int)_chunk), GRANULE);
+
+  // The size classes only cover blocks smaller than 16MB
+  if (size > RT_ALLOC_TLSF_MAX_SIZE) {
+    rt_trace(RT_TRACE_ALLOC, "Chunk too big, only using the first 0x%x bytes (alloc: %p, size: 0x%x)\n", RT_ALLOC_TLSF_MAX_SIZE, a, size);
+    size = RT_ALLOC_TLSF_MAX_SIZE;
+  }
+
+  memset((void *)a, 0, sizeof(rt_alloc_t));
+
+  // Reserve the edge bitmap at the beginning of the chunk, with one bit per granule
+  // of the whole chunk, which is a bit more than needed but simpler.
+  int edges_size = ALIGN_UP(((size >> GRANULE_LOG2) + 31) / 32 * 4, GRANULE);
+  if (size <= edges_size) {
+    a->base = a->end = chunk;
+    return;
+  }
+
+  a->edges = (unsigned int *)chunk;
+  memset((void *)a->edges, 0, edges_size);
+  a->base = chunk + edges_size;
+  a->end = chunk + size;
+
+  __rt_tlsf_insert(a, (rt_alloc_tlsf_block_t *)a->base, size - edges_size);
+}
+
+static inline int __rt_tlsf_size(int size)
+{
+  size = ALIGN_UP(size, GRANULE);
+  if (size == 0) size = GRANULE;
+  return size;
+}
+
+static void *__rt_user_alloc(rt_alloc_t *a, int size)
+{
+  rt_trace(RT_TRACE_ALLOC, "Allocating memory chunk (alloc: %p, size: 0x%8x)\n", a, size);
+
+  size = __rt_tlsf_size(size);
+
+  rt_alloc_tlsf_block_t *block = __rt_tlsf_find(a, __rt_tlsf_round(size));
+  if (block == NULL) {
+    rt_trace(RT_TRACE_ALLOC, "Not enough memory to allocate\n");
+    return NULL;
+  }
+
+  __rt_tlsf_remove(a, block);
+
+  // As for the first-fit allocator, return the end of the block so that the
+  // remaining free block stays in place
+  int remaining = block->size - size;
+  if (remaining) __rt_tlsf_insert(a, block, remaining);
+
+  void *result = (void *)((unsigned int)block + remaining);
+  rt_trace(RT_TRACE_ALLOC, "Allocated memory chunk (alloc: %p, base: %p)\n", a, result);
+  return result;
+}
+
+static void *__rt_user_alloc_align(rt_alloc_t *a, int size, int align)
+{
+  if (align <= GRANULE) return __rt_user_alloc(a, size);
+
+  size = __rt_tlsf_size(size);
+
+  // All blocks are aligned on the granule, so the room before the aligned
+  // chunk is always either empty or big enough to be a free block
+  rt_alloc_tlsf_block_t *block = __rt_tlsf_find(a, __rt_tlsf_round(size + align - GRANULE));
+  if (block == NULL) return NULL;
+
+  __rt_tlsf_remove(a, block);
+
+  unsigned int start = (unsigned int)block;
+  unsigned int end = start + block->size;
+  unsigned int result = ALIGN_UP(start, align);
+
+  if (result != start) __rt_tlsf_insert(a, block, result - start);
+  if (result + size != end) __rt_tlsf_insert(a, (rt_alloc_tlsf_block_t *)(result + size), end - result - size);
+
+  return (void *)result;
+}
+
+static void __rt_user_free(rt_alloc_t *a, void *_chunk, int size)
+{
+  rt_trace(RT_TRACE_ALLOC, "Freeing memory chunk (alloc: %p, base: %p, size: 0x%8x)\n", a, _chunk, size);
+
+  unsigned int start = (unsigned int)_chunk;
+  size = __rt_tlsf_size(size);
+  unsigned int end = start + size;
+
+  // Coalesce with next block if its first granule is marked
+  if (end < a->end && __rt_tlsf_edge_get(a, end)) {
+    rt_alloc_tlsf_block_t *next = (rt_alloc_tlsf_block_t *)end;
+    size += next->size;
+    __rt_tlsf_remove(a, next);
+  }
+
+  // Coalesce with previous block if its last granule is marked, its size
+  // is then found in the last word
+  if (start > a->base && __rt_tlsf_edge_get(a, start - GRANULE)) {
+    int prev_size = *(int *)(start - 4);
+    start -= prev_size;
+    size += prev_size;
+    __rt_tlsf_remove(a, (rt_alloc_tlsf_block_t *)start);
+  }
+
+  __rt_tlsf_insert(a, (rt_alloc_tlsf_block_t *)start, size);
+}
+
+void *rt_user_alloc(rt_alloc_t *a, int size)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  void *result = __rt_user_alloc(a, size);
+  __rt_alloc_stats_alloc(&a->stats, result, __rt_tlsf_size(size), start);
+  return result;
+}
+
+void *rt_user_alloc_align(rt_alloc_t *a, int size, int align)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  void *result = __rt_user_alloc_align(a, size, align);
+  __rt_alloc_stats_alloc(&a->stats, result, __rt_tlsf_size(size), start);
+  return result;
+}
+
+void __attribute__((noinline)) rt_user_free(rt_alloc_t *a, void *_chunk, int size)
+{
+  unsigned int start = __rt_alloc_stats_start();
+  __rt_user_free(a, _chunk, size);
+  __rt_alloc_stats_free(&a->stats, __rt_tlsf_size(size), start);
+}
+
+// Try to resize the chunk in place, the sizes must be already rounded
+static int __rt_user_resize(rt_alloc_t *a, void *_chunk, int old_size, int new_size)
+{
+  unsigned int end = (unsigned int)_chunk + old_size;
+
+  if (new_size <= old_size)
+  {
+    if (new_size < old_size) __rt_user_free(a, (void *)((unsigned int)_chunk + new_size), old_size - new_size);
+    return 0;
+  }
+
+  // The next block is free if its first granule is marked
+  if (end >= a->end || !__rt_tlsf_edge_get(a, end)) return -1;
+
+  rt_alloc_tlsf_block_t *next = (rt_alloc_tlsf_block_t *)end;
+  int needed = new_size - old_size;
+  int remaining = next->size - needed;
+  if (remaining < 0) return -1;
+
+  __rt_tlsf_remove(a, next);
+  if (remaining) __rt_tlsf_insert(a, (rt_alloc_tlsf_block_t *)((unsigned int)_chunk + new_size), remaining);
+
+  return 0;
+}
+
+void *rt_user_realloc(rt_alloc_t *a, void *_chunk, int old_size, int new_size)
+{
+  if (_chunk == NULL) return rt_user_alloc(a, new_size);
+
+  if (new_size == 0)
+  {
+    rt_user_free(a, _chunk, old_size);
+    return NULL;
+  }
+
+  unsigned int start = __rt_alloc_stats_start();
+  int old_aligned = __rt_tlsf_size(old_size);
+  int new_aligned = __rt_tlsf_size(new_size);
+
+  if (__rt_user_resize(a, _chunk, old_aligned, new_aligned) == 0)
+  {
+    __rt_alloc_stats_resize(&a->stats, old_aligned, new_aligned, start);
+    return _chunk;
+  }
+
+  void *result = rt_user_alloc(a, new_size);
+  if (result == NULL) return NULL;
+
+  memcpy(result, _chunk, old_size);
+  rt_user_free(a, _chunk, old_size);
+
+  return result;
+}
+
+void rt_user_alloc_stats(rt_alloc_t *a, rt_alloc_stats_t *stats)
+{
+  *stats = a->stats;
+  stats->largest_free = 0;
+
+  // The biggest block is in the highest non-empty class
+  if (a->fl_bitmap)
+  {
+    int fl = __FL1(a->fl_bitmap);
+    int sl = __FL1(a->sl_bitmap[fl]);
+    for (rt_alloc_tlsf_block_t *pt = a->heads[fl][sl]; pt; pt = pt->next) {
+      if ((unsigned int)pt->size > stats->largest_free) stats->largest_free = pt->size;
+    }
+  }
+}
+
+#endif
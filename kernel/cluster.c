@@ -24,7 +24,8 @@
 #if defined(ARCHI_HAS_CLUSTER)
 
 rt_fc_cluster_data_t *__rt_fc_cluster_data;
-RT_L1_TINY_DATA __rt_cluster_call_t __rt_cluster_call[2];
+static __rt_cluster_mount_t *__rt_cluster_mounts;
+RT_L1_TINY_DATA __rt_cluster_call_t __rt_cluster_call[RT_CLUSTER_CALL_DEPTH];
 RT_L1_TINY_DATA rt_event_sched_t *__rt_cluster_sched_current;
 
 void __rt_enqueue_event();
@@ -57,47 +58,92 @@ static void __rt_init_cluster_data(int cid)
   memset(rt_cluster_tiny_addr(cid, __rt_cluster_call), 0, sizeof(__rt_cluster_call));
 
   __rt_fc_cluster_data[cid].call_stacks = NULL;
+  __rt_fc_cluster_data[cid].call_stacks_size = 0;
+  __rt_fc_cluster_data[cid].call_stacks_pinned = 0;
+  __rt_fc_cluster_data[cid].call_stacks_retired = NULL;
   __rt_fc_cluster_data[cid].trig_addr = eu_evt_trig_cluster_addr(cid, RT_CLUSTER_CALL_EVT);
 }
 
-static inline __attribute__((always_inline)) void __rt_cluster_mount(int cid, int flags, rt_event_t *event)
+// This continuation does all the steps required to power-up the cluster.
+// This can execute in 2 ways:
+//   - No event is given in which case each call is synchronous and the call 
+//     to this function will just do all steps in one shot
+//   - An event is given in which case, the function will just execute one asynchronous
+//     step and will continue with the next step once it is called again by the event
+//     execution, so that the FC can execute other events while the PMU is powering up
+//     the cluster
+static int __rt_cluster_mount_step(void *arg)
 {
-  rt_trace(RT_TRACE_CONF, "Mounting cluster (cluster: %d)\n", cid);
+  __rt_cluster_mount_t *mount = (__rt_cluster_mount_t *)arg;
+  rt_event_t *event = mount->step_event;
+  int cid = mount->cid;
 
-  if (rt_is_fc() || (cid && !rt_has_fc()))
+  RT_ASYNC_BEGIN(&mount->async);
+
+  // Power-up the cluster
+  // For now the PMU is only supporting one cluster
+  if (cid == 0)
   {
-    // Power-up the cluster
-    // For now the PMU is only supporting one cluster
-    if (cid == 0) __rt_pmu_cluster_power_up();
+    __rt_pmu_cluster_power_up(event);
+    RT_ASYNC_AWAIT(&mount->async, event);
+  }
+
+  // The rest of the sequence is short and is done in one step with interrupts disabled
+  // as for the synchronous mount
+  int irq = hal_irq_disable();
 
 #ifdef FLL_VERSION
-    if (rt_platform() != ARCHI_PLATFORM_FPGA)
-    {
-      // Setup FLL
-      __rt_fll_init(1);
-    }
+  if (rt_platform() != ARCHI_PLATFORM_FPGA)
+  {
+    // Setup FLL
+    __rt_fll_init(1);
+  }
 #endif
 
-    // Initialize cluster global variables
-    __rt_init_cluster_data(cid);
+  // Initialize cluster global variables
+  __rt_init_cluster_data(cid);
 
-    // Initialize cluster L1 memory allocator
-    __rt_alloc_init_l1(cid);
+  // Initialize cluster L1 memory allocator
+  __rt_alloc_init_l1(cid);
 
 #if defined(APB_SOC_VERSION) && APB_SOC_VERSION >= 2
 
-    // Fetch all cores, they will directly jump to the PE loop waiting from orders through the dispatcher
-    for (int i=0; i<rt_nb_pe(); i++) {
-      plp_ctrl_core_bootaddr_set_remote(cid, i, ((int)_start) & 0xffffff00);
-    }
-    eoc_fetch_enable_remote(cid, -1);
-
-    // For now the whole sequence is blocking so we just handle the event here.
-    // The power-up sequence could be done asynchronously and would then use the event
-    if (event) rt_event_push(event);
+  // Fetch all cores, they will directly jump to the PE loop waiting from orders through the dispatcher
+  for (int i=0; i<rt_nb_pe(); i++) {
+    plp_ctrl_core_bootaddr_set_remote(cid, i, ((int)_start) & 0xffffff00);
+  }
+  eoc_fetch_enable_remote(cid, -1);
 
 #endif
 
+  if (mount->event) rt_event_push(mount->event);
+
+  hal_irq_restore(irq);
+
+  RT_ASYNC_END(&mount->async);
+}
+
+static inline __attribute__((always_inline)) void __rt_cluster_mount(int cid, int flags, rt_event_t *event)
+{
+  rt_trace(RT_TRACE_CONF, "Mounting cluster (cluster: %d)\n", cid);
+
+  if (rt_is_fc() || (cid && !rt_has_fc()))
+  {
+    __rt_cluster_mount_t *mount = &__rt_cluster_mounts[cid];
+
+    // If the user specified an event, we must do all intermediate steps
+    // asynchronously with another event, otherwise just do everything
+    // synchronously with no event
+    mount->cid = cid;
+    mount->event = event;
+    if (event) {
+      mount->step_event = rt_async_init(&mount->async, event->sched, __rt_cluster_mount_step, (void *)mount);
+    } else {
+      rt_async_init(&mount->async, NULL, __rt_cluster_mount_step, (void *)mount);
+      mount->step_event = NULL;
+    }
+
+    __rt_cluster_mount_step((void *)mount);
   }
   else
   {
@@ -155,12 +201,10 @@ void rt_cluster_mount(int mount, int cid, int flags, rt_event_t *event)
 
 
 
-int rt_cluster_call(rt_cluster_call_t *_call, int cid, void (*entry)(void *arg), void *arg, void *stacks, int master_stack_size, int slave_stack_size, int nb_pe, rt_event_t *event)
+// Get the next free call structure of the cluster call queue, must be called with interrupts disabled
+static __rt_cluster_call_t *__rt_cluster_call_alloc(rt_fc_cluster_data_t *cluster, int cid)
 {
-  int retval = 0;
-  int irq = hal_irq_disable();
   __rt_cluster_call_t *call;
-  rt_fc_cluster_data_t *cluster = &__rt_fc_cluster_data[cid];
 
   // Loop until we get a free cluster call structure
   // It is important to reload the index after a wake-up, as another thread could have pushed something
@@ -169,35 +213,23 @@ int rt_cluster_call(rt_cluster_call_t *_call, int cid, void (*entry)(void *arg),
     int index = cluster->call_head;
     call = rt_cluster_tiny_addr(cid, &__rt_cluster_call[index]);
 
-    // Go to sleep if there is noone available
     if ((*(volatile int *)&call->nb_pe) == 0) break;
 
-    __rt_thread_sleep();
+    // The cluster frees the slot when it takes the call but does not notify the FC,
+    // e.g. for the intermediate calls of a batch, so nothing would wake us up if we
+    // went to sleep. Instead keep executing events and check again periodically.
+    if (rt_is_fc()) rt_event_execute_timeout(NULL, RT_CLUSTER_CALL_POLL_US);
   } while(1);
 
-  cluster->call_head ^= 1;
-
-  if (cluster->call_stacks != NULL) {
-    rt_free(RT_ALLOC_CL_DATA+cid, cluster->call_stacks, cluster->call_stacks_size);
-    cluster->call_stacks = NULL;
-  }
-
-  // If no stack is specified, choose a default one.
-  if (master_stack_size == 0) master_stack_size = rt_cl_master_stack_size_get();
-  if (slave_stack_size == 0) slave_stack_size = rt_cl_slave_stack_size_get();
-  if (stacks == NULL)
-  {
-    cluster->call_stacks_size = master_stack_size + slave_stack_size*nb_pe;
-    stacks = rt_alloc(RT_ALLOC_CL_DATA+cid, cluster->call_stacks_size);
-    if (stacks == NULL) {
-      retval = -1;
-      goto end;
-    }
-    cluster->call_stacks = stacks;
-  }
+  if (++cluster->call_head == RT_CLUSTER_CALL_DEPTH) cluster->call_head = 0;
 
-  rt_event_t *call_event = __rt_wait_event_prepare(event);
+  return call;
+}
 
+// Fill-in a call structure so that it is executed by the cluster, must be called with interrupts disabled.
+// The event is only pushed to the FC when the call returns if notify is set
+static void __rt_cluster_call_push(__rt_cluster_call_t *call, int cid, void (*entry)(void *arg), void *arg, void *stacks, int master_stack_size, int slave_stack_size, int nb_pe, rt_event_t *event, int notify)
+{
   // Fill-in the call request
   call->entry = entry;
   call->arg = arg;
@@ -205,8 +237,8 @@ int rt_cluster_call(rt_cluster_call_t *_call, int cid, void (*entry)(void *arg),
   call->stacks = (void *)((int)stacks + master_stack_size);
   call->master_stack_size = master_stack_size;
   call->slave_stack_size = slave_stack_size;
-  call->event = call_event;
-  call->sched = call_event->sched;
+  call->event = notify ? event : NULL;
+  call->sched = event->sched;
 
   // nb_pe must be last written as this is the one triggering the execution on cluster side
   rt_compiler_barrier();
@@ -214,6 +246,166 @@ int rt_cluster_call(rt_cluster_call_t *_call, int cid, void (*entry)(void *arg),
 
   // And trigger an event on cluster side in case it is sleeping
   eu_evt_trig(eu_evt_trig_cluster_addr(cid, RT_CLUSTER_CALL_EVT), 1);
+}
+
+// Entry of the call used to know when the cluster is done with the retired stacks
+static void __rt_cluster_stacks_drain(void *arg)
+{
+}
+
+// Executed once the cluster has returned from all the calls enqueued before the drain call
+static void __rt_cluster_stacks_free(void *arg)
+{
+  rt_fc_cluster_data_t *cluster = (rt_fc_cluster_data_t *)arg;
+  int cid = cluster - __rt_fc_cluster_data;
+  int irq = hal_irq_disable();
+  rt_free(RT_ALLOC_CL_DATA+cid, cluster->call_stacks_retired, cluster->call_stacks_retired_size);
+  cluster->call_stacks_retired = NULL;
+  hal_irq_restore(irq);
+}
+
+// Free the current stacks once the calls which may still use them are over. This is done by
+// enqueueing an empty call behind them and freeing the stacks when it returns.
+// Must be called with interrupts disabled
+static int __rt_cluster_stacks_retire(rt_fc_cluster_data_t *cluster, int cid)
+{
+  if (cluster->call_stacks == NULL) return 0;
+
+  // Only one region can be retired at a time
+  while (cluster->call_stacks_retired) __rt_event_execute(NULL, 1);
+
+  rt_event_t *event = rt_event_get(NULL, __rt_cluster_stacks_free, (void *)cluster);
+  if (event == NULL) return -1;
+
+  cluster->call_stacks_retired = cluster->call_stacks;
+  cluster->call_stacks_retired_size = cluster->call_stacks_size;
+  cluster->call_stacks = NULL;
+
+  // The drain call can use the retired stacks as they are valid until it returns
+  __rt_cluster_call_t *call = __rt_cluster_call_alloc(cluster, cid);
+  __rt_cluster_call_push(call, cid, __rt_cluster_stacks_drain, NULL, cluster->call_stacks_retired, cluster->call_stacks_retired_size, 0, 1, event, 1);
+
+  return 0;
+}
+
+// Get the stacks to be used by a call, allocating them if they are not specified,
+// must be called with interrupts disabled
+static void *__rt_cluster_call_stacks(rt_fc_cluster_data_t *cluster, int cid, void *stacks, int master_stack_size, int slave_stack_size, int nb_pe)
+{
+  if (stacks) return stacks;
+
+  // The calls are executed one after the other, so the same stacks can be used by all
+  // the calls as long as they are big enough
+  int size = master_stack_size + slave_stack_size*nb_pe;
+  if (cluster->call_stacks != NULL && cluster->call_stacks_size >= size) return cluster->call_stacks;
+
+  if (cluster->call_stacks_pinned) return NULL;
+
+  // The region is sized for the biggest configuration requested so far so that it
+  // is reallocated as few times as possible
+  if (size < cluster->call_stacks_size) size = cluster->call_stacks_size;
+
+  if (__rt_cluster_stacks_retire(cluster, cid)) return NULL;
+
+  cluster->call_stacks_size = size;
+  cluster->call_stacks = rt_alloc(RT_ALLOC_CL_DATA+cid, size);
+
+  return cluster->call_stacks;
+}
+
+int rt_cluster_stacks_pin(int cid, int master_stack_size, int slave_stack_size, int nb_pe)
+{
+  int irq = hal_irq_disable();
+  rt_fc_cluster_data_t *cluster = &__rt_fc_cluster_data[cid];
+
+  if (master_stack_size == 0) master_stack_size = rt_cl_master_stack_size_get();
+  if (slave_stack_size == 0) slave_stack_size = rt_cl_slave_stack_size_get();
+  if (nb_pe == 0) nb_pe = rt_nb_pe();
+
+  cluster->call_stacks_pinned = 0;
+  void *stacks = __rt_cluster_call_stacks(cluster, cid, NULL, master_stack_size, slave_stack_size, nb_pe);
+  if (stacks) cluster->call_stacks_pinned = 1;
+
+  hal_irq_restore(irq);
+  return stacks ? 0 : -1;
+}
+
+int rt_cluster_stacks_release(int cid)
+{
+  int irq = hal_irq_disable();
+  rt_fc_cluster_data_t *cluster = &__rt_fc_cluster_data[cid];
+
+  cluster->call_stacks_pinned = 0;
+  int retval = __rt_cluster_stacks_retire(cluster, cid);
+  if (retval == 0) cluster->call_stacks_size = 0;
+
+  hal_irq_restore(irq);
+  return retval;
+}
+
+int rt_cluster_call(rt_cluster_call_t *_call, int cid, void (*entry)(void *arg), void *arg, void *stacks, int master_stack_size, int slave_stack_size, int nb_pe, rt_event_t *event)
+{
+  int retval = 0;
+  int irq = hal_irq_disable();
+  rt_fc_cluster_data_t *cluster = &__rt_fc_cluster_data[cid];
+
+  // If no stack is specified, choose a default one.
+  // This must be done before reserving the call structure as a call may be enqueued to
+  // free the previous stacks
+  if (master_stack_size == 0) master_stack_size = rt_cl_master_stack_size_get();
+  if (slave_stack_size == 0) slave_stack_size = rt_cl_slave_stack_size_get();
+  stacks = __rt_cluster_call_stacks(cluster, cid, stacks, master_stack_size, slave_stack_size, nb_pe);
+  if (stacks == NULL) {
+    retval = -1;
+    goto end;
+  }
+
+  __rt_cluster_call_t *call = __rt_cluster_call_alloc(cluster, cid);
+
+  rt_event_t *call_event = __rt_wait_event_prepare(event);
+
+  __rt_cluster_call_push(call, cid, entry, arg, stacks, master_stack_size, slave_stack_size, nb_pe, call_event, 1);
+
+  if (rt_is_fc()) __rt_wait_event_check(event, call_event);
+
+end:
+  hal_irq_restore(irq);
+  return retval;
+}
+
+int rt_cluster_call_batch(int cid, rt_cluster_batch_t *calls, int nb_calls, void *stacks, int master_stack_size, int slave_stack_size, rt_event_t *event)
+{
+  int retval = 0;
+  int irq = hal_irq_disable();
+  rt_fc_cluster_data_t *cluster = &__rt_fc_cluster_data[cid];
+
+  // The stacks are shared by all the calls so they must be big enough for the
+  // one using the most cores
+  int nb_pe = 0;
+  for (int i=0; i<nb_calls; i++)
+  {
+    if (calls[i].nb_pe > nb_pe) nb_pe = calls[i].nb_pe;
+  }
+
+  if (master_stack_size == 0) master_stack_size = rt_cl_master_stack_size_get();
+  if (slave_stack_size == 0) slave_stack_size = rt_cl_slave_stack_size_get();
+  stacks = __rt_cluster_call_stacks(cluster, cid, stacks, master_stack_size, slave_stack_size, nb_pe);
+  if (stacks == NULL) {
+    retval = -1;
+    goto end;
+  }
+
+  rt_event_t *call_event = __rt_wait_event_prepare(event);
+
+  if (nb_calls == 0) __rt_event_enqueue(call_event);
+
+  // Only the last call notifies the FC, the cluster goes through the other ones
+  // without sending anything
+  for (int i=0; i<nb_calls; i++)
+  {
+    __rt_cluster_call_t *call = __rt_cluster_call_alloc(cluster, cid);
+    __rt_cluster_call_push(call, cid, calls[i].entry, calls[i].arg, stacks, master_stack_size, slave_stack_size, calls[i].nb_pe, call_event, i == nb_calls - 1);
+  }
 
   if (rt_is_fc()) __rt_wait_event_check(event, call_event);
 
@@ -222,6 +414,103 @@ end:
   return retval;
 }
 
+static void __rt_cluster_fork_entry(void *arg)
+{
+  __rt_cluster_fork_range_t *range = (__rt_cluster_fork_range_t *)arg;
+  rt_cluster_fork_t *fork = range->fork;
+  fork->entry(fork->arg, range->first, range->last);
+}
+
+// Executed on FC each time a cluster has returned, must be called with interrupts disabled
+static void __rt_cluster_fork_join(rt_cluster_fork_t *fork)
+{
+  if (--fork->pending == 0) rt_event_push(fork->event);
+}
+
+static void __rt_cluster_fork_done(void *arg)
+{
+  int irq = hal_irq_disable();
+  __rt_cluster_fork_join((rt_cluster_fork_t *)arg);
+  hal_irq_restore(irq);
+}
+
+int rt_cluster_fork(rt_cluster_fork_t *fork, unsigned int cluster_mask, int nb_items, void (*entry)(void *arg, int first, int last), void *arg, int nb_pe, rt_event_t *event)
+{
+  int retval = 0;
+  int irq = hal_irq_disable();
+
+  int nb_cluster = rt_nb_cluster();
+  if (nb_cluster > RT_CLUSTER_FORK_NB_CLUSTER) nb_cluster = RT_CLUSTER_FORK_NB_CLUSTER;
+  cluster_mask &= (1 << nb_cluster) - 1;
+
+  int nb_forked = 0;
+  for (int cid=0; cid<nb_cluster; cid++)
+  {
+    if ((cluster_mask >> cid) & 1) nb_forked++;
+  }
+
+  if (nb_pe == 0) nb_pe = rt_nb_pe();
+
+  rt_event_t *call_event = __rt_wait_event_prepare(event);
+
+  fork->entry = entry;
+  fork->arg = arg;
+  fork->event = call_event;
+  fork->pending = nb_forked;
+
+  if (nb_forked == 0)
+  {
+    rt_event_push(call_event);
+    goto end;
+  }
+
+  // Each cluster notifies its termination with its own event, which just decrements
+  // the number of pending clusters. They are all reserved first so that nothing is started
+  // if there are not enough events
+  rt_event_t *cluster_event = rt_event_get_chain(call_event->sched, nb_forked, __rt_cluster_fork_done, (void *)fork);
+  if (cluster_event == NULL)
+  {
+    retval = -1;
+    rt_event_push(call_event);
+    goto end;
+  }
+
+  int first = 0;
+  int index = 0;
+  for (int cid=0; cid<nb_cluster; cid++)
+  {
+    if (((cluster_mask >> cid) & 1) == 0) continue;
+
+    // The remaining items are given to the first clusters, one each
+    int size = nb_items / nb_forked + (index < nb_items % nb_forked);
+    __rt_cluster_fork_range_t *range = &fork->ranges[cid];
+    range->fork = fork;
+    range->first = first;
+    range->last = first + size;
+    first += size;
+    index++;
+
+    // The event is linked to the next one until it is pushed by the cluster
+    rt_event_t *next = cluster_event->next;
+
+    if (rt_cluster_call(NULL, cid, __rt_cluster_fork_entry, (void *)range, NULL, 0, 0, nb_pe, cluster_event))
+    {
+      // The cluster could not be started, just consider it is over
+      retval = -1;
+      __rt_event_release(cluster_event);
+      __rt_cluster_fork_join(fork);
+    }
+
+    cluster_event = next;
+  }
+
+end:
+  if (rt_is_fc()) __rt_wait_event_check(event, call_event);
+
+  hal_irq_restore(irq);
+  return retval;
+}
+
 static RT_FC_BOOT_CODE int __rt_cluster_init(void *arg)
 {
   int nb_cluster = rt_nb_cluster();
@@ -235,6 +524,12 @@ static RT_FC_BOOT_CODE int __rt_cluster_init(void *arg)
 
   memset(__rt_fc_cluster_data, 0, data_size);
 
+  __rt_cluster_mounts = rt_alloc(RT_ALLOC_FC_DATA, sizeof(__rt_cluster_mount_t)*nb_cluster);
+  if (__rt_cluster_mounts == NULL) {
+    rt_fatal("Unable to allocate cluster control structure\n");
+    return -1;
+  }
+
   rt_irq_set_handler(RT_FC_ENQUEUE_EVENT, __rt_remote_enqueue_event);
   rt_irq_mask_set(1<<RT_FC_ENQUEUE_EVENT);
 
@@ -246,19 +541,28 @@ static RT_FC_BOOT_CODE int __rt_cluster_init(void *arg)
 
 void __rt_cluster_push_fc_event(rt_event_t *event)
 {
+  rt_fc_cluster_data_t *data = &__rt_fc_cluster_data[rt_cluster_id()];
+
+  // Events are posted through a ring where the cluster only writes the head and
+  // the FC only writes the tail, so the FC never has to synchronize with the cluster.
+  // The mutex is only used to serialize the PEs of this cluster while they reserve
+  // a slot, which is a few cycles.
   eu_mutex_lock(eu_mutex_addr(0));
 
-  rt_fc_cluster_data_t *data = &__rt_fc_cluster_data[rt_cluster_id()];
+  unsigned int head = data->events_head;
 
-  // First wait until the slot to post events is free
-  while(data->events != NULL)
+  // Only wait if the ring is full, the FC notifies the cluster each time it frees a slot
+  while(head - *(volatile unsigned int *)&data->events_tail == RT_FC_CLUSTER_NB_EVENTS)
   {
     eu_evt_maskWaitAndClr(1<<RT_CLUSTER_CALL_EVT);
   }
 
-  // Push the event and notify the FC with a HW evet in case it
-  // is sleeping
-  data->events = event;
+  // The slot must be written before the new head is visible to the FC
+  data->events[head & (RT_FC_CLUSTER_NB_EVENTS - 1)] = event;
+  __asm__ __volatile__ ("" : : : "memory");
+  *(volatile unsigned int *)&data->events_head = head + 1;
+
+  // Notify the FC with a HW evet in case it is sleeping
 #ifdef ITC_VERSION
   hal_itc_status_set(1<<RT_FC_ENQUEUE_EVENT);
 #else
@@ -291,6 +595,26 @@ int rt_cluster_call(rt_cluster_call_t *_call, int cid, void (*entry)(void *arg),
   return 0;
 }
 
+int rt_cluster_call_batch(int cid, rt_cluster_batch_t *calls, int nb_calls, void *stacks, int master_stack_size, int slave_stack_size, rt_event_t *event)
+{
+  return 0;
+}
+
+int rt_cluster_fork(rt_cluster_fork_t *fork, unsigned int cluster_mask, int nb_items, void (*entry)(void *arg, int first, int last), void *arg, int nb_pe, rt_event_t *event)
+{
+  return 0;
+}
+
+int rt_cluster_stacks_pin(int cid, int master_stack_size, int slave_stack_size, int nb_pe)
+{
+  return 0;
+}
+
+int rt_cluster_stacks_release(int cid)
+{
+  return 0;
+}
+
 #endif
 
 
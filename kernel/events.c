@@ -23,10 +23,24 @@
 
 RT_FC_TINY_DATA rt_event_sched_t   __rt_sched;
 RT_FC_TINY_DATA rt_event_t        *__rt_first_free = NULL;
+RT_FC_TINY_DATA rt_event_stats_t   __rt_event_stats;
+
+// Memory reserved through rt_event_alloc_reserve, from which events are added to the
+// free list in batches. The low-water mark is negative when there is no reserve, so
+// that it is never reached.
+static rt_event_t *__rt_event_reserve_current;
+static rt_event_t *__rt_event_reserve_end;
+static rt_event_sched_t *__rt_event_reserve_sched;
+static int __rt_event_low_water = -1;
+static int __rt_event_batch;
 
 void rt_event_sched_init(rt_event_sched_t *sched)
 {
-  sched->first = NULL;
+  for (int i=0; i<RT_EVENT_NB_PRIO; i++)
+  {
+    sched->fifos[i].first = NULL;
+  }
+  sched->prios = 0;
   sched->waiting = NULL;
 }
 
@@ -37,24 +51,51 @@ void __rt_event_init(rt_event_t *event, rt_event_sched_t *sched)
   event->callback = NULL;
 }
 
+// Events allocated from the fabric controller are taken from this pool and given back
+// to it when they are freed, so that event descriptors are recycled without going
+// through the memory allocator.
+static rt_pool_t __rt_event_pool;
+
 int rt_event_alloc(rt_event_sched_t *sched, int nb_events)
 {
   int irq = hal_irq_disable();
 
   if (!sched) sched = __rt_thread_current->sched;
 
-  int flags;
-  if (rt_is_fc()) flags = RT_ALLOC_FC_DATA;
-  else flags = RT_ALLOC_CL_DATA + rt_cluster_id();
+  if (rt_is_fc())
+  {
+    rt_pool_t *pool = &__rt_event_pool;
 
-  rt_event_t *event = (rt_event_t *)rt_alloc(flags, sizeof(rt_event_t)*nb_events);
-  if (event == NULL) return -1;
+    if (pool->nb_free < nb_events && rt_pool_grow(pool, nb_events - pool->nb_free))
+    {
+      hal_irq_restore(irq);
+      return -1;
+    }
 
-  for (int i=0; i<nb_events; i++) {
-    __rt_event_init(event, sched);
-    event->next = __rt_first_free;
-    __rt_first_free = event;
-    event++;
+    for (int i=0; i<nb_events; i++) {
+      rt_event_t *event = (rt_event_t *)rt_pool_alloc(pool);
+      __rt_event_init(event, sched);
+      event->next = __rt_first_free;
+      __rt_first_free = event;
+    }
+    __rt_event_stats.nb_free += nb_events;
+  }
+  else
+  {
+    rt_event_t *event = (rt_event_t *)rt_alloc(RT_ALLOC_CL_DATA + rt_cluster_id(), sizeof(rt_event_t)*nb_events);
+    if (event == NULL)
+    {
+      hal_irq_restore(irq);
+      return -1;
+    }
+
+    for (int i=0; i<nb_events; i++) {
+      __rt_event_init(event, sched);
+      event->next = __rt_first_free;
+      __rt_first_free = event;
+      event++;
+    }
+    __rt_event_stats.nb_free += nb_events;
   }
 
   hal_irq_restore(irq);
@@ -63,6 +104,8 @@ int rt_event_alloc(rt_event_sched_t *sched, int nb_events)
 
 void rt_event_free(rt_event_sched_t *sched, int nb_events)
 {
+  int irq = hal_irq_disable();
+
   for (int i=0; i<nb_events; i++)
   {
     rt_event_t *event = __rt_first_free;
@@ -70,19 +113,25 @@ void rt_event_free(rt_event_sched_t *sched, int nb_events)
     rt_free(RT_ALLOC_PERIPH, (void *)event->copy.periph_data, RT_PERIPH_COPY_PERIPH_DATA_SIZE);
 #endif
     __rt_first_free = event->next;   
-    rt_free(RT_ALLOC_FC_DATA, (void *)event, sizeof(rt_event_t));
+    rt_pool_free(&__rt_event_pool, (void *)event);
   }
+  __rt_event_stats.nb_free -= nb_events;
+
+  hal_irq_restore(irq);
 }
 
 static inline __attribute__((always_inline)) void __rt_enqueue_event_to_sched(rt_event_sched_t *sched, rt_event_t *event)
 {
+  __rt_event_trace(RT_EVENT_TRACE_ENQUEUE, event, event->callback);
+  rt_event_fifo_t *fifo = &sched->fifos[event->prio];
   event->next = NULL;
-  if (sched->first == NULL) {
-    sched->first = event;
+  if (fifo->first == NULL) {
+    fifo->first = event;
   } else {
-    sched->last->next = event;
+    fifo->last->next = event;
   }
-  sched->last = event;
+  fifo->last = event;
+  sched->prios |= 1 << event->prio;
 }
 
 static inline __attribute__((always_inline)) void __rt_wakeup_thread(rt_event_sched_t *sched)
@@ -103,17 +152,83 @@ static inline __attribute__((always_inline)) void __rt_push_event(rt_event_sched
   __rt_wakeup_thread(sched);
 }
 
+// Move events from the reserve to the free list, at least the specified number
+// if the reserve is big enough
+static void __rt_event_refill(int nb_events)
+{
+  int nb = __rt_event_batch > nb_events ? __rt_event_batch : nb_events;
+  int nb_reserved = __rt_event_reserve_end - __rt_event_reserve_current;
+  if (nb > nb_reserved) nb = nb_reserved;
+  if (nb == 0) return;
+
+  for (int i=0; i<nb; i++)
+  {
+    rt_event_t *event = __rt_event_reserve_current++;
+    __rt_event_init(event, __rt_event_reserve_sched);
+    event->next = __rt_first_free;
+    __rt_first_free = event;
+  }
+
+  __rt_event_stats.nb_free += nb;
+  __rt_event_stats.nb_reserved -= nb;
+  __rt_event_stats.nb_refill++;
+}
+
+static inline __attribute__((always_inline)) void __rt_event_account_get(int nb_events)
+{
+  __rt_event_stats.nb_free -= nb_events;
+  __rt_event_stats.nb_used += nb_events;
+  if (__rt_event_stats.nb_used > __rt_event_stats.peak_used)
+    __rt_event_stats.peak_used = __rt_event_stats.nb_used;
+}
+
 static inline __attribute__((always_inline)) rt_event_t *__rt_get_event(rt_event_sched_t *sched, void (*callback)(void *), void *arg)
 {
+  if (unlikely(__rt_event_stats.nb_free <= __rt_event_low_water)) __rt_event_refill(1);
+
   // Get event from scheduler and initialize it
   rt_event_t *event = __rt_first_free;
-  if (event == NULL) return NULL;
+  if (event == NULL)
+  {
+    __rt_event_stats.nb_exhausted++;
+    return NULL;
+  }
   __rt_first_free = event->next;
+  __rt_event_account_get(1);
   event->callback = callback;
   event->arg = arg;
+  event->prio = RT_EVENT_PRIO_DEFAULT;
   return event;
 }
 
+int rt_event_alloc_reserve(rt_event_sched_t *sched, int nb_events, int low_water, int batch)
+{
+  if (!rt_is_fc() || __rt_event_reserve_end) return -1;
+
+  rt_event_t *events = (rt_event_t *)rt_alloc(RT_ALLOC_FC_DATA, sizeof(rt_event_t)*nb_events);
+  if (events == NULL) return -1;
+
+  int irq = hal_irq_disable();
+
+  __rt_event_reserve_sched = sched ? sched : __rt_thread_current->sched;
+  __rt_event_reserve_current = events;
+  __rt_event_reserve_end = events + nb_events;
+  __rt_event_batch = batch > 0 ? batch : 1;
+  __rt_event_low_water = low_water;
+  __rt_event_stats.nb_reserved = nb_events;
+
+  hal_irq_restore(irq);
+
+  return 0;
+}
+
+void rt_event_stats(rt_event_stats_t *stats)
+{
+  int irq = hal_irq_disable();
+  *stats = __rt_event_stats;
+  hal_irq_restore(irq);
+}
+
 rt_event_t *rt_event_get(rt_event_sched_t *sched, void (*callback)(void *), void *arg)
 {
   int irq = hal_irq_disable();
@@ -137,6 +252,64 @@ rt_event_t *rt_event_get_blocking(rt_event_sched_t *sched)
   return event;
 }
 
+rt_event_t *rt_event_get_chain(rt_event_sched_t *sched, int nb_events, void (*callback)(void *), void *arg)
+{
+  int irq = hal_irq_disable();
+
+  if (!sched) sched = __rt_thread_current->sched;
+
+  if (unlikely(__rt_event_stats.nb_free - nb_events <= __rt_event_low_water))
+    __rt_event_refill(nb_events - __rt_event_stats.nb_free);
+
+  // Events are already linked together in the free list, so we just need to
+  // initialize them and cut the list after the last one
+  rt_event_t *first = __rt_first_free;
+  rt_event_t *event = first;
+  rt_event_t *last = NULL;
+  for (int i=0; i<nb_events; i++)
+  {
+    if (event == NULL)
+    {
+      __rt_event_stats.nb_exhausted++;
+      hal_irq_restore(irq);
+      return NULL;
+    }
+    event->callback = callback;
+    event->arg = arg;
+    event->prio = RT_EVENT_PRIO_DEFAULT;
+    event->sched = sched;
+    last = event;
+    event = event->next;
+  }
+
+  if (last)
+  {
+    __rt_first_free = last->next;
+    last->next = NULL;
+    __rt_event_account_get(nb_events);
+  }
+  else
+  {
+    first = NULL;
+  }
+
+  hal_irq_restore(irq);
+  return first;
+}
+
+void rt_event_push_chain(rt_event_t *event)
+{
+  int irq = hal_irq_disable();
+  while (event)
+  {
+    rt_event_t *next = event->next;
+    __rt_enqueue_event_to_sched(event->sched, event);
+    __rt_wakeup_thread(event->sched);
+    event = next;
+  }
+  hal_irq_restore(irq);
+}
+
 void rt_event_push(rt_event_t *event)
 {
   int irq = hal_irq_disable();
@@ -148,7 +321,12 @@ int rt_event_push_callback(rt_event_sched_t *sched, void (*callback)(void *), vo
 {
   int irq = hal_irq_disable();
   rt_event_t *event = __rt_get_event(sched, callback, arg);
-  if (event == NULL) return -1;
+  if (event == NULL)
+  {
+    hal_irq_restore(irq);
+    return -1;
+  }
+  event->sched = sched;
   __rt_push_event(sched, event);
   hal_irq_restore(irq);
   return 0;
@@ -163,12 +341,21 @@ void __rt_event_unblock(rt_event_t *event)
   }
 }
 
+static inline __attribute__((always_inline)) rt_event_t *__rt_event_pop(rt_event_sched_t *sched)
+{
+  int prio = __FL1(sched->prios);
+  rt_event_fifo_t *fifo = &sched->fifos[prio];
+  rt_event_t *event = fifo->first;
+  fifo->first = event->next;
+  if (fifo->first == NULL) sched->prios &= ~(1 << prio);
+  return event;
+}
+
 void __rt_event_execute(rt_event_sched_t *sched, int wait)
 {
   if (sched == NULL) sched = __rt_thread_current->sched;
-  rt_event_t *event = sched->first;
 
-  if (event == NULL) {
+  if (sched->prios == 0) {
     if (wait) {
       // Pop first event from the queue. Loop until we pop a null event
       // We must always read again the queue head, as the executed
@@ -177,7 +364,7 @@ void __rt_event_execute(rt_event_sched_t *sched, int wait)
       sched->waiting = __rt_thread_current;
 
       do {
-        if (__rt_ready_queue.first) {
+        if (__rt_ready_queue.prios) {
           __rt_thread_sleep();
         }
         else {
@@ -185,39 +372,52 @@ void __rt_event_execute(rt_event_sched_t *sched, int wait)
           hal_irq_enable();
           hal_irq_disable();
         }
-        event = *((rt_event_t * volatile *)&sched->first);
-      } while (!event);
+      } while (*(volatile unsigned int *)&sched->prios == 0);
     } else {
       hal_irq_enable();
       return;
     }
   }
 
+  // The highest priority level is selected again after each event, so that
+  // an event pushed by a callback or an interrupt handler with a higher
+  // priority is executed first.
+  // Only the executed event is removed from its FIFO, the others stay in the scheduler
+  // so that they can be executed by a nested executor, e.g. a callback blocking on
+  // a semaphore, or by another thread of the same scheduler.
   do {
-    sched->first = event->next;
+    rt_event_t *event = __rt_event_pop(sched);
 
     // Read event information and put it back in the scheduler
     void (*callback)(void *) = event->callback;
     void *arg = event->arg;
 
+    __rt_event_trace(RT_EVENT_TRACE_DEQUEUE, event, callback);
+
     // Free the event now so that it can be used directly from the callback
     if (!event->pending) {
-      event->next = __rt_first_free;
-      __rt_first_free = event;
+      __rt_event_release(event);
     }
 
-    // Finally execute the event with interrupts enabled
-    if (callback) {
+    // Finally execute the event with interrupts enabled, unless it is a periodic event
+    // which was cancelled while waiting in the scheduler
+    if (callback && event->pending != __RT_EVENT_PENDING_CANCELLED) {
+      __rt_event_trace(RT_EVENT_TRACE_CB_START, event, callback);
       hal_irq_enable();
       callback(arg);
       hal_irq_disable();
+      __rt_event_trace(RT_EVENT_TRACE_CB_END, event, callback);
     }
 
+    int cancelled = event->pending == __RT_EVENT_PENDING_CANCELLED;
+
     __rt_event_unblock(event);
 
-    event = sched->first;
+    // A periodic event cancelled while it was kept pending could not be released
+    // before its execution
+    if (cancelled) __rt_event_release(event);
 
-  } while(event);
+  } while(sched->prios);
 
 }
 
@@ -228,13 +428,20 @@ void __rt_wait_event(rt_event_t *event)
     __rt_event_execute(__rt_thread_current->sched, 1);
   }
 
+  // The event of the thread, which is used when no event is given to a
+  // blocking call, does not come from the free list
   rt_event_sched_t *sched = event->sched;
-  if (sched) {
-    event->next = __rt_first_free;
-    __rt_first_free = event;
+  if (sched && event != &__rt_thread_current->event) {
+    __rt_event_release(event);
   }
 }
 
+void __rt_async_resume(void *arg)
+{
+  rt_async_t *async = (rt_async_t *)arg;
+  async->entry(async->arg);
+}
+
 void rt_event_wait(rt_event_t *event)
 {
   int irq = hal_irq_disable();
@@ -245,4 +452,136 @@ __rt_wait_event(event);
 RT_FC_BOOT_CODE void __attribute__((constructor)) __rt_event_sched_init()
 {
   rt_event_sched_init(&__rt_sched);
+  rt_pool_init(&__rt_event_pool, RT_ALLOC_FC_DATA, sizeof(rt_event_t), 0);
 }
+
+
+
+#if defined(__RT_EVENT_TRACE)
+
+RT_L2_DATA rt_event_trace_t __rt_event_trace_buffer[RT_EVENT_TRACE_SIZE];
+RT_FC_TINY_DATA unsigned int __rt_event_trace_index;
+
+// Maximum number of different callbacks reported
+#define RT_EVENT_TRACE_NB_CALLBACKS 16
+// Histograms have one bucket per number of significant bits of the duration
+#define RT_EVENT_TRACE_NB_BUCKETS   32
+
+typedef struct {
+  void *callback;
+  unsigned int wait[RT_EVENT_TRACE_NB_BUCKETS];
+  unsigned int exec[RT_EVENT_TRACE_NB_BUCKETS];
+} rt_event_trace_stats_t;
+
+int rt_event_trace_get(rt_event_trace_t *records)
+{
+  int irq = hal_irq_disable();
+  unsigned int index = __rt_event_trace_index;
+  int nb_records = index < RT_EVENT_TRACE_SIZE ? index : RT_EVENT_TRACE_SIZE;
+  for (int i=0; i<nb_records; i++)
+  {
+    records[i] = __rt_event_trace_buffer[(index - nb_records + i) & (RT_EVENT_TRACE_SIZE - 1)];
+  }
+  hal_irq_restore(irq);
+  return nb_records;
+}
+
+static inline int __rt_event_trace_bucket(unsigned int duration)
+{
+  return duration ? __FL1(duration) : 0;
+}
+
+static int __rt_event_trace_find(rt_event_trace_t *records, int index, void *object, int type)
+{
+  for (int i=index-1; i>=0; i--)
+  {
+    if (records[i].object == object && records[i].type == type) return i;
+  }
+  return -1;
+}
+
+static void __rt_event_trace_print_histo(unsigned int *histo)
+{
+  for (int i=0; i<RT_EVENT_TRACE_NB_BUCKETS; i++)
+  {
+    if (histo[i]) printf("  [%llu, %llu[: %d", i ? 1ULL << i : 0, 2ULL << i, histo[i]);
+  }
+  printf("\n");
+}
+
+void rt_event_trace_report()
+{
+  // The report is big, so the records and the statistics are allocated only for
+  // the time of the report
+  rt_event_trace_t *records = rt_alloc(RT_ALLOC_PERIPH, sizeof(rt_event_trace_t)*RT_EVENT_TRACE_SIZE);
+  rt_event_trace_stats_t *stats = rt_alloc(RT_ALLOC_PERIPH, sizeof(rt_event_trace_stats_t)*RT_EVENT_TRACE_NB_CALLBACKS);
+  if (records == NULL || stats == NULL) goto end;
+
+  int nb_records = rt_event_trace_get(records);
+  int nb_stats = 0;
+
+  int irq = hal_irq_disable();
+  __rt_event_trace_index = 0;
+  hal_irq_restore(irq);
+
+  memset(stats, 0, sizeof(rt_event_trace_stats_t)*RT_EVENT_TRACE_NB_CALLBACKS);
+
+  for (int i=0; i<nb_records; i++)
+  {
+    rt_event_trace_t *record = &records[i];
+    int start_type;
+
+    if (record->type == RT_EVENT_TRACE_DEQUEUE) start_type = RT_EVENT_TRACE_ENQUEUE;
+    else if (record->type == RT_EVENT_TRACE_CB_END) start_type = RT_EVENT_TRACE_CB_START;
+    else continue;
+
+    // Each dequeue and callback end is matched with the previous enqueue or callback start of
+    // the same event. Events whose start was overwritten in the ring are ignored.
+    int start = __rt_event_trace_find(records, i, record->object, start_type);
+    if (start == -1) continue;
+
+    rt_event_trace_stats_t *cb_stats = NULL;
+    for (int j=0; j<nb_stats; j++)
+    {
+      if (stats[j].callback == record->callback) { cb_stats = &stats[j]; break; }
+    }
+    if (cb_stats == NULL)
+    {
+      if (nb_stats == RT_EVENT_TRACE_NB_CALLBACKS) continue;
+      cb_stats = &stats[nb_stats++];
+      cb_stats->callback = record->callback;
+    }
+
+    int bucket = __rt_event_trace_bucket(record->time - records[start].time);
+    if (record->type == RT_EVENT_TRACE_DEQUEUE) cb_stats->wait[bucket]++;
+    else cb_stats->exec[bucket]++;
+  }
+
+  printf("Event trace report (%d records, durations in cycles)\n", nb_records);
+  for (int i=0; i<nb_stats; i++)
+  {
+    printf("Callback %p\n wait:", stats[i].callback);
+    __rt_event_trace_print_histo(stats[i].wait);
+    printf(" exec:");
+    __rt_event_trace_print_histo(stats[i].exec);
+  }
+
+end:
+  if (records) rt_free(RT_ALLOC_PERIPH, records, sizeof(rt_event_trace_t)*RT_EVENT_TRACE_SIZE);
+  if (stats) rt_free(RT_ALLOC_PERIPH, stats, sizeof(rt_event_trace_stats_t)*RT_EVENT_TRACE_NB_CALLBACKS);
+}
+
+#else
+
+// Tracing is not compiled in, there is never any record
+
+int rt_event_trace_get(rt_event_trace_t *records)
+{
+  return 0;
+}
+
+void rt_event_trace_report()
+{
+}
+
+#endif
@@ -47,48 +47,85 @@ void __rt_pmu_cluster_power_down()
   }
 }
 
-void __rt_pmu_cluster_power_up()
+// The PMU is only supporting one cluster, so there is only one power-up sequence
+static rt_async_t __rt_pmu_async;
+static rt_event_t *__rt_pmu_step_event;
+static rt_event_t *__rt_pmu_event;
+static PMU_BypassT __rt_pmu_bypass;
+
+// Wait until the specified SoC event is received. In asynchronous mode, the event status
+// is polled from a delayed event so that the FC can execute other events in the meantime
+#define __RT_PMU_WAIT_EVENT(soc_event)                            \
+  do {                                                            \
+    if (event == NULL) __rt_periph_wait_event(soc_event, 1);      \
+    else                                                          \
+    {                                                             \
+      while (!__rt_periph_check_event(soc_event, 1))              \
+      {                                                           \
+        rt_event_push_delayed(event, RT_PMU_POLL_US);             \
+        RT_ASYNC_AWAIT(&__rt_pmu_async, event);                   \
+      }                                                           \
+    }                                                             \
+  } while(0)
+
+static int __rt_pmu_cluster_power_up_step(void *arg)
 {
-  if (rt_platform() == ARCHI_PLATFORM_FPGA)
+  rt_event_t *event = __rt_pmu_step_event;
+
+  RT_ASYNC_BEGIN(&__rt_pmu_async);
+
+  __rt_pmu_bypass.Raw = GetPMUBypass();
+  
+  if (__rt_pmu_bypass.Fields.ClusterClockGate == 0)
   {
-    // On the FPGA the only thing to manage is the cluster isolation
-    PMU_IsolateCluster(0);
+    /* Clock gate FLL cluster */
+    __rt_pmu_bypass.Fields.ClusterClockGate = 1; SetPMUBypass(__rt_pmu_bypass.Raw);
+
+    /* Wait for clock gate done event */
+    __RT_PMU_WAIT_EVENT(ARCHI_SOC_EVENT_ICU_DELAYED);
   }
-  else
-  {
-    PMU_BypassT Bypass;
 
-    Bypass.Raw = GetPMUBypass();
-    
-    if (Bypass.Fields.ClusterClockGate == 0)
-    {
-      /* Clock gate FLL cluster */
-      Bypass.Fields.ClusterClockGate = 1; SetPMUBypass(Bypass.Raw);
+  /* Turn on power */
+  __rt_pmu_bypass.Fields.ClusterState = 1; SetPMUBypass(__rt_pmu_bypass.Raw);
 
-      /* Wait for clock gate done event */
-      __rt_periph_wait_event(ARCHI_SOC_EVENT_ICU_DELAYED, 1);
-    }
+  /* Wait for TRC OK event */
+  __RT_PMU_WAIT_EVENT(ARCHI_SOC_EVENT_CLUSTER_ON_OFF);
 
-    /* Turn on power */
-    Bypass.Fields.ClusterState = 1; SetPMUBypass(Bypass.Raw);
+  /* De assert Isolate on cluster */
+  PMU_IsolateCluster(0);
 
-    /* Wait for TRC OK event */
-    __rt_periph_wait_event(ARCHI_SOC_EVENT_CLUSTER_ON_OFF, 1);
+  /* De Assert Reset cluster */
+  __rt_pmu_bypass.Fields.ClusterReset = 0; SetPMUBypass(__rt_pmu_bypass.Raw);
 
-    /* De assert Isolate on cluster */
-    PMU_IsolateCluster(0);
+  /* Clock ungate FLL cluster */
+  __rt_pmu_bypass.Fields.ClusterClockGate = 0; SetPMUBypass(__rt_pmu_bypass.Raw);
 
-    /* De Assert Reset cluster */
-    Bypass.Fields.ClusterReset = 0; SetPMUBypass(Bypass.Raw);
+  /* Wait for clock gate done event */
+  __RT_PMU_WAIT_EVENT(ARCHI_SOC_EVENT_ICU_DELAYED);
 
-    /* Clock ungate FLL cluster */
-    Bypass.Fields.ClusterClockGate = 0; SetPMUBypass(Bypass.Raw);
+  /* Tell external loader (such as gdb) that the cluster is on so that it can take it into account */
+  __rt_pmu_bypass.Raw |= 1 << APB_SOC_BYPASS_USER0_BIT; SetPMUBypass(__rt_pmu_bypass.Raw);
 
-    /* Wait for clock gate done event */
-      __rt_periph_wait_event(ARCHI_SOC_EVENT_ICU_DELAYED, 1);
+  if (event) rt_event_push(__rt_pmu_event);
+
+  RT_ASYNC_END(&__rt_pmu_async);
+}
+
+void __rt_pmu_cluster_power_up(rt_event_t *event)
+{
+  if (rt_platform() == ARCHI_PLATFORM_FPGA)
+  {
+    // On the FPGA the only thing to manage is the cluster isolation
+    PMU_IsolateCluster(0);
+    if (event) rt_event_push(event);
+  }
+  else
+  {
+    __rt_pmu_event = event;
+    __rt_pmu_step_event = rt_async_init(&__rt_pmu_async, event ? event->sched : NULL, __rt_pmu_cluster_power_up_step, NULL);
+    if (event == NULL) __rt_pmu_step_event = NULL;
 
-    /* Tell external loader (such as gdb) that the cluster is on so that it can take it into account */
-    Bypass.Raw |= 1 << APB_SOC_BYPASS_USER0_BIT; SetPMUBypass(Bypass.Raw);
+    __rt_pmu_cluster_power_up_step(NULL);
   }
 }
 
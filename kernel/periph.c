@@ -193,6 +193,26 @@ void __rt_periph_wait_event(int event, int clear)
   hal_irq_restore(irq);
 }
 
+int __rt_periph_check_event(int event, int clear)
+{
+  int irq = hal_irq_disable();
+
+  int index = 0;
+  if (event >= 32)
+  {
+    index = 1;
+    event -= 32;
+  }
+
+  int result = (__rt_socevents_status[index] >> event) & 1;
+
+  if (result && clear) __rt_socevents_status[index] &= ~(1<<event);
+
+  hal_irq_restore(irq);
+
+  return result;
+}
+
 void __rt_periph_clear_event(int event)
 {
   int irq = hal_irq_disable();
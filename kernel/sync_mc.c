@@ -20,51 +20,6 @@
 
 #include "rt/rt_api.h"
 
-static inline unsigned int __rt_tas_addr(unsigned int addr) {
-  return addr | (1<<ARCHI_L1_TAS_BIT);
-}
-
-static inline int rt_tas_lock_8(unsigned int addr) {
-  __asm__ __volatile__ ("" : : : "memory");
-  int result = *(volatile unsigned char *)__rt_tas_addr(addr);
-  __asm__ __volatile__ ("" : : : "memory");
-  return result;
-}
-
-static inline void rt_tas_unlock_8(unsigned int addr, unsigned char value) {
-  __asm__ __volatile__ ("" : : : "memory");
-  *(volatile unsigned char *)addr = value;
-  __asm__ __volatile__ ("" : : : "memory");
-}
-
-static inline int rt_tas_lock_16(unsigned int addr) {
-  __asm__ __volatile__ ("" : : : "memory");
-  int result = *(volatile unsigned short *)__rt_tas_addr(addr);
-  __asm__ __volatile__ ("" : : : "memory");
-  return result;
-}
-
-static inline void rt_tas_unlock_16(unsigned int addr, unsigned short value) {
-  __asm__ __volatile__ ("" : : : "memory");
-  *(volatile unsigned short *)addr = value;
-  __asm__ __volatile__ ("" : : : "memory");
-}
-
-static inline int rt_tas_lock_32(unsigned int addr) {
-  __asm__ __volatile__ ("" : : : "memory");
-  int result = *(volatile unsigned int *)__rt_tas_addr(addr);
-  __asm__ __volatile__ ("" : : : "memory");
-  return result;
-}
-
-static inline void rt_tas_unlock_32(unsigned int addr, unsigned int value) {
-  __asm__ __volatile__ ("" : : : "memory");
-  *(volatile unsigned int *)addr = value;
-  __asm__ __volatile__ ("" : : : "memory");
-}
-
-
-
 void rt_iclock_conf_init(rt_iclock_conf_t *conf)
 {
   conf->cluster_mask = (1<<rt_nb_cluster()) - 1;
@@ -104,6 +59,10 @@ rt_iclock_t *rt_iclock_alloc(rt_iclock_conf_t *conf)
 
   // Allocate the global FC structure pointing to all per-cluster structures
   // The cluster structures pointers are put at the end of the global structure
+  // Contrary to other descriptors, these ones are not recycled through a pool:
+  // the global structure size depends on the number of clusters, and the
+  // per-cluster structures live in cluster L1 memory, whose allocator is reset
+  // at each mount, so that objects kept in a pool would not survive a power-off.
   int lock_size = sizeof(rt_iclock_t) + nb_cluster * sizeof(void *);
   rt_iclock_t *lock = (rt_iclock_t *)rt_alloc(RT_ALLOC_FC_DATA, lock_size);
   if (lock == NULL) return NULL;
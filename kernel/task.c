@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* 
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "rt/rt_api.h"
+
+// Scheduler currently executing tasks on this cluster
+static RT_L1_TINY_DATA rt_task_sched_t *__rt_task_sched_current;
+
+static inline void __rt_task_lock(unsigned int *lock)
+{
+  // Critical sections are only a few instructions so just spin
+  while (rt_tas_lock_32((unsigned int)lock) == -1);
+}
+
+static inline void __rt_task_unlock(unsigned int *lock)
+{
+  rt_tas_unlock_32((unsigned int)lock, 0);
+}
+
+// Push a task at the tail of the deque, returns 0 if it is full
+static int __rt_task_push(__rt_task_deque_t *deque, void (*entry)(void *), void *arg)
+{
+  int result = 0;
+  __rt_task_lock(&deque->lock);
+  if (deque->tail - deque->head != RT_TASK_DEQUE_SIZE)
+  {
+    __rt_task_t *task = &deque->tasks[deque->tail & (RT_TASK_DEQUE_SIZE - 1)];
+    task->entry = entry;
+    task->arg = arg;
+    deque->tail++;
+    result = 1;
+  }
+  __rt_task_unlock(&deque->lock);
+  return result;
+}
+
+// Pop the last pushed task of the deque, used by the owner of the deque
+static int __rt_task_pop(__rt_task_deque_t *deque, __rt_task_t *task)
+{
+  int result = 0;
+  __rt_task_lock(&deque->lock);
+  if (deque->tail != deque->head)
+  {
+    deque->tail--;
+    *task = deque->tasks[deque->tail & (RT_TASK_DEQUE_SIZE - 1)];
+    result = 1;
+  }
+  __rt_task_unlock(&deque->lock);
+  return result;
+}
+
+// Pop the first pushed task of the deque, used by the other cores to steal work
+static int __rt_task_steal_one(__rt_task_deque_t *deque, __rt_task_t *task)
+{
+  int result = 0;
+  __rt_task_lock(&deque->lock);
+  if (deque->tail != deque->head)
+  {
+    *task = deque->tasks[deque->head & (RT_TASK_DEQUE_SIZE - 1)];
+    deque->head++;
+    result = 1;
+  }
+  __rt_task_unlock(&deque->lock);
+  return result;
+}
+
+static int __rt_task_steal(rt_task_sched_t *sched, int id, __rt_task_t *task)
+{
+  // Start from the next core so that the victims are spread over the cores
+  int victim = id;
+  for (int i=1; i<sched->nb_pe; i++)
+  {
+    if (++victim == sched->nb_pe) victim = 0;
+
+    __rt_task_deque_t *deque = &sched->deques[victim];
+
+    // Check first without the lock to not disturb the owner of an empty deque
+    if (*(volatile unsigned int *)&deque->tail == *(volatile unsigned int *)&deque->head) continue;
+
+    if (__rt_task_steal_one(deque, task)) return 1;
+  }
+  return 0;
+}
+
+static int __rt_task_available(rt_task_sched_t *sched)
+{
+  for (int i=0; i<sched->nb_pe; i++)
+  {
+    __rt_task_deque_t *deque = &sched->deques[i];
+    if (*(volatile unsigned int *)&deque->tail != *(volatile unsigned int *)&deque->head) return 1;
+  }
+  return 0;
+}
+
+static void __rt_task_wakeup(rt_task_sched_t *sched)
+{
+  unsigned int sleeping = *(volatile unsigned int *)&sched->sleeping;
+  if (sleeping) eu_evt_trig(sched->trig_addr, sleeping);
+}
+
+static void __rt_task_done(rt_task_sched_t *sched)
+{
+  __rt_task_lock(&sched->lock);
+  int last = --sched->nb_pending == 0;
+  __rt_task_unlock(&sched->lock);
+
+  // Wake-up everybody when the last task is over so that they can leave
+  if (last) __rt_task_wakeup(sched);
+}
+
+static void __rt_task_idle(rt_task_sched_t *sched, int id)
+{
+  // Register as sleeping before checking again for tasks, so that a task spawned in the meantime
+  // is either seen now or triggers the event, which is then kept by the event unit until we wait for it
+  __rt_task_lock(&sched->lock);
+  sched->sleeping |= 1 << id;
+  __rt_task_unlock(&sched->lock);
+
+  if (!__rt_task_available(sched) && *(volatile int *)&sched->nb_pending != 0)
+  {
+    eu_evt_maskWaitAndClr(1<<RT_CLUSTER_TASK_EVT);
+  }
+
+  __rt_task_lock(&sched->lock);
+  sched->sleeping &= ~(1 << id);
+  __rt_task_unlock(&sched->lock);
+}
+
+static void __rt_task_worker(void *arg)
+{
+  rt_task_sched_t *sched = (rt_task_sched_t *)arg;
+  int id = rt_core_id();
+  __rt_task_t task;
+
+  while (1)
+  {
+    if (__rt_task_pop(&sched->deques[id], &task) || __rt_task_steal(sched, id, &task))
+    {
+      task.entry(task.arg);
+      __rt_task_done(sched);
+    }
+    else
+    {
+      if (*(volatile int *)&sched->nb_pending == 0) break;
+
+      __rt_task_idle(sched, id);
+    }
+  }
+}
+
+void rt_task_spawn(void (*entry)(void *), void *arg)
+{
+  rt_task_sched_t *sched = __rt_task_sched_current;
+
+  // The task must be accounted before it is visible, otherwise the other cores
+  // could see no pending task and leave
+  __rt_task_lock(&sched->lock);
+  sched->nb_pending++;
+  __rt_task_unlock(&sched->lock);
+
+  if (!__rt_task_push(&sched->deques[rt_core_id()], entry, arg))
+  {
+    entry(arg);
+    __rt_task_done(sched);
+    return;
+  }
+
+  __rt_task_wakeup(sched);
+}
+
+void rt_task_run(rt_task_sched_t *sched, int nb_cores, void (*entry)(void *), void *arg)
+{
+  int nb_pe = nb_cores ? nb_cores : rt_nb_active_pe();
+  if (nb_pe > RT_TASK_NB_PE) nb_pe = RT_TASK_NB_PE;
+
+  sched->lock = 0;
+  sched->sleeping = 0;
+  sched->nb_pe = nb_pe;
+  sched->trig_addr = eu_evt_trig_cluster_addr(rt_cluster_id(), RT_CLUSTER_TASK_EVT);
+
+  for (int i=0; i<nb_pe; i++)
+  {
+    __rt_task_deque_t *deque = &sched->deques[i];
+    deque->lock = 0;
+    deque->head = 0;
+    deque->tail = 0;
+  }
+
+  // The first task is given to the master core
+  sched->nb_pending = 1;
+  __rt_task_push(&sched->deques[0], entry, arg);
+
+  __rt_task_sched_current = sched;
+
+  rt_team_fork(nb_pe, __rt_task_worker, (void *)sched);
+}
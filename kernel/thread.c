@@ -20,7 +20,7 @@
 
 #include "rt/rt_api.h"
 
-RT_FC_TINY_DATA rt_thread_queue_t __rt_ready_queue;
+RT_FC_TINY_DATA rt_thread_ready_queue_t __rt_ready_queue;
 RT_FC_GLOBAL_DATA static rt_thread_t __rt_thread_main;
 RT_FC_TINY_DATA rt_thread_t *__rt_thread_current;
 
@@ -28,11 +28,64 @@ extern void __rt_thread_switch(rt_thread_t *current, rt_thread_t *new);
 extern void __rt_thread_start();
 
 
+#if defined(ARCHI_HAS_FC)
+// Periodic event executed from the timer interrupt handler to implement time slicing
+static rt_event_t __rt_thread_slice_event;
+static int __rt_thread_slice_expired;
+#endif
+
 static void __rt_thread_queue_init(rt_thread_queue_t *queue)
 {
   queue->first = NULL;
 }
 
+static void __rt_thread_ready_queue_init(rt_thread_ready_queue_t *queue)
+{
+  for (int i=0; i<RT_THREAD_NB_PRIO; i++)
+  {
+    __rt_thread_queue_init(&queue->queues[i]);
+  }
+  queue->prios = 0;
+}
+
+static void __rt_thread_remove_ready(rt_thread_t *thread)
+{
+  rt_thread_queue_t *queue = &__rt_ready_queue.queues[thread->prio];
+  rt_thread_t *prev = NULL;
+  for (rt_thread_t *current = queue->first; current; current = current->next)
+  {
+    if (current == thread)
+    {
+      if (prev) prev->next = thread->next;
+      else queue->first = thread->next;
+      if (queue->last == thread) queue->last = prev;
+      break;
+    }
+    prev = current;
+  }
+  if (queue->first == NULL) __rt_ready_queue.prios &= ~(1 << thread->prio);
+}
+
+// Switch to the first ready thread of the highest priority if it has a higher priority than the
+// current one, or the same one if the current thread has to give the processor.
+// This must be called with interrupts disabled.
+static void __rt_thread_schedule(int same_prio)
+{
+  rt_thread_t *current = __rt_thread_current;
+
+  if (__rt_ready_queue.prios == 0) return;
+
+  int prio = __FL1(__rt_ready_queue.prios);
+  if (prio > current->prio || (same_prio && prio == current->prio))
+  {
+    __rt_thread_enqueue_ready(current);
+    rt_thread_t *new = __rt_thread_dequeue_ready();
+    __rt_thread_current = new;
+    __rt_event_trace(RT_EVENT_TRACE_SWITCH, new, NULL);
+    __rt_thread_switch(current, new);
+  }
+}
+
 void __rt_thread_enqueue(rt_thread_queue_t *queue, rt_thread_t *thread)
 {
   thread->next = NULL;
@@ -54,6 +107,7 @@ static void __rt_thread_init(rt_thread_t *thread, void *(*entry)(void *), void *
   thread->u.regs.s2 = (int)rt_thread_exit;
   thread->sched = &__rt_sched;
   thread->state = RT_THREAD_STATE_OTHER;
+  thread->prio = RT_THREAD_PRIO_DEFAULT;
   __rt_event_init(&thread->event, &__rt_sched);
 }
 
@@ -65,6 +119,7 @@ void rt_thread_yield()
   rt_thread_t *new = __rt_thread_dequeue_ready();
   if (new != current) {    
     __rt_thread_current = new;
+    __rt_event_trace(RT_EVENT_TRACE_SWITCH, new, NULL);
     __rt_thread_switch(current, new);
   }
   hal_irq_restore(irq);
@@ -73,11 +128,17 @@ void rt_thread_yield()
 void __rt_thread_sleep()
 {
   rt_thread_t *current = __rt_thread_current;
+
+  // Mark the thread as blocked so that it is not preempted while it is waiting
+  // for an interrupt
+  current->state = RT_THREAD_STATE_WAITING;
+
   do {
     rt_thread_t *new = __rt_thread_dequeue_ready();
     if (new) {
       if (new != current) {
         __rt_thread_current = new;
+        __rt_event_trace(RT_EVENT_TRACE_SWITCH, new, NULL);
         __rt_thread_switch(current, new);
       }
       break;
@@ -106,6 +167,64 @@ int rt_thread_create(rt_thread_t *thread, void *(*entry)(void *), void *arg, uns
   return 0;
 }
 
+void rt_thread_set_prio(rt_thread_t *thread, int prio)
+{
+  int irq = hal_irq_disable();
+
+  if (thread == NULL) thread = __rt_thread_current;
+
+  if (thread->state == RT_THREAD_STATE_READY)
+  {
+    __rt_thread_remove_ready(thread);
+    thread->prio = prio;
+    __rt_thread_enqueue_ready(thread);
+  }
+  else
+  {
+    thread->prio = prio;
+  }
+
+  __rt_thread_schedule(0);
+
+  hal_irq_restore(irq);
+}
+
+#if defined(ARCHI_HAS_FC)
+
+static void __rt_thread_slice_handler(void *arg)
+{
+  __rt_thread_slice_expired = 1;
+}
+
+void rt_thread_time_slice(int us)
+{
+  int irq = hal_irq_disable();
+  rt_event_cancel_delayed(&__rt_thread_slice_event);
+  if (us) rt_event_push_periodic(&__rt_thread_slice_event, us);
+  hal_irq_restore(irq);
+}
+
+#endif
+
+// Called at the end of the timer interrupt handler, with the interrupted context saved
+// on the stack of the current thread, so that it can be switched like a thread which
+// blocked. The context is restored when the thread is scheduled again.
+void __rt_thread_preempt()
+{
+#if defined(ARCHI_HAS_FC)
+  int expired = __rt_thread_slice_expired;
+  __rt_thread_slice_expired = 0;
+#else
+  int expired = 0;
+#endif
+
+  // A thread which is waiting for an interrupt is not running and will schedule
+  // the ready threads by itself
+  if (__rt_thread_current->state != RT_THREAD_STATE_OTHER) return;
+
+  __rt_thread_schedule(expired);
+}
+
 void rt_thread_exit(void *status)
 {
   hal_irq_disable();
@@ -136,9 +255,213 @@ void *rt_thread_join(rt_thread_t *thread)
   return status;
 }
 
+// The wait queues of the synchronization objects are linked through a dedicated field, as
+// a blocked thread still executes the events of its scheduler with interrupts enabled, and
+// can then be put in the ready queue when it is preempted.
+static void __rt_thread_wait_enqueue(rt_thread_queue_t *queue, rt_thread_t *thread)
+{
+  thread->wait_next = NULL;
+  if (queue->first == NULL) {
+    queue->first = thread;
+  } else {
+    queue->last->wait_next = thread;
+  }
+  queue->last = thread;
+}
+
+static rt_thread_t *__rt_thread_wait_dequeue(rt_thread_queue_t *queue)
+{
+  rt_thread_t *result = queue->first;
+  if (result) {
+    queue->first = result->wait_next;
+  }
+  return result;
+}
+
+// Block the calling thread in the specified queue until it is woken-up by __rt_thread_wait_wakeup.
+// The thread event is used to wake it up so that the thread keeps executing the events of
+// its scheduler while it is waiting.
+// This must be called with interrupts disabled.
+static void __rt_thread_wait(rt_thread_queue_t *queue, void *data)
+{
+  rt_thread_t *current = __rt_thread_current;
+  rt_event_t *event = __rt_wait_event_prepare(NULL);
+  event->sched = current->sched;
+  current->wait_data = data;
+  __rt_thread_wait_enqueue(queue, current);
+  __rt_wait_event(event);
+}
+
+// Wake-up the first thread of the queue and return it, or NULL if there is none.
+// This must be called with interrupts disabled.
+static rt_thread_t *__rt_thread_wait_wakeup(rt_thread_queue_t *queue)
+{
+  rt_thread_t *thread = __rt_thread_wait_dequeue(queue);
+  if (thread) rt_event_push(&thread->event);
+  return thread;
+}
+
+void rt_sem_init(rt_sem_t *sem, int value)
+{
+  sem->count = value;
+  __rt_thread_queue_init(&sem->waiting);
+}
+
+void rt_sem_wait(rt_sem_t *sem)
+{
+  int irq = hal_irq_disable();
+  // When the semaphore is posted, the token is directly given to the first waiting
+  // thread, so there is nothing to do once it is woken-up
+  if (sem->count > 0) sem->count--;
+  else __rt_thread_wait(&sem->waiting, NULL);
+  hal_irq_restore(irq);
+}
+
+int rt_sem_trywait(rt_sem_t *sem)
+{
+  int result = -1;
+  int irq = hal_irq_disable();
+  if (sem->count > 0) {
+    sem->count--;
+    result = 0;
+  }
+  hal_irq_restore(irq);
+  return result;
+}
+
+void rt_sem_post(rt_sem_t *sem)
+{
+  int irq = hal_irq_disable();
+  if (__rt_thread_wait_wakeup(&sem->waiting) == NULL) sem->count++;
+  hal_irq_restore(irq);
+}
+
+void rt_cond_init(rt_cond_t *cond)
+{
+  __rt_thread_queue_init(&cond->waiting);
+}
+
+void rt_cond_wait(rt_cond_t *cond)
+{
+  __rt_thread_wait(&cond->waiting, NULL);
+}
+
+void rt_cond_signal(rt_cond_t *cond)
+{
+  int irq = hal_irq_disable();
+  __rt_thread_wait_wakeup(&cond->waiting);
+  hal_irq_restore(irq);
+}
+
+void rt_cond_broadcast(rt_cond_t *cond)
+{
+  int irq = hal_irq_disable();
+  while (__rt_thread_wait_wakeup(&cond->waiting));
+  hal_irq_restore(irq);
+}
+
+void rt_msgq_init(rt_msgq_t *msgq, void *buffer, int elem_size, int nb_elems)
+{
+  msgq->buffer = (char *)buffer;
+  msgq->elem_size = elem_size;
+  msgq->nb_elems = nb_elems;
+  msgq->head = 0;
+  msgq->count = 0;
+  __rt_thread_queue_init(&msgq->receivers);
+  __rt_thread_queue_init(&msgq->senders);
+}
+
+static inline char *__rt_msgq_elem(rt_msgq_t *msgq, int index)
+{
+  if (index >= msgq->nb_elems) index -= msgq->nb_elems;
+  return msgq->buffer + index * msgq->elem_size;
+}
+
+// Must be called with interrupts disabled
+static int __rt_msgq_send(rt_msgq_t *msgq, const void *msg)
+{
+  // A waiting receiver means the queue is empty, give it the message directly
+  rt_thread_t *receiver = msgq->receivers.first;
+  if (receiver)
+  {
+    memcpy(receiver->wait_data, msg, msgq->elem_size);
+    __rt_thread_wait_wakeup(&msgq->receivers);
+    return 0;
+  }
+
+  if (msgq->count == msgq->nb_elems) return -1;
+
+  memcpy(__rt_msgq_elem(msgq, msgq->head + msgq->count), msg, msgq->elem_size);
+  msgq->count++;
+  return 0;
+}
+
+// Must be called with interrupts disabled
+static int __rt_msgq_receive(rt_msgq_t *msgq, void *msg)
+{
+  if (msgq->count == 0) return -1;
+
+  memcpy(msg, __rt_msgq_elem(msgq, msgq->head), msgq->elem_size);
+
+  // A waiting sender means the queue was full, put its message into the slot
+  // which has just been freed
+  rt_thread_t *sender = msgq->senders.first;
+  if (sender)
+  {
+    memcpy(__rt_msgq_elem(msgq, msgq->head), sender->wait_data, msgq->elem_size);
+    __rt_thread_wait_wakeup(&msgq->senders);
+  }
+  else
+  {
+    msgq->count--;
+  }
+
+  msgq->head++;
+  if (msgq->head == msgq->nb_elems) msgq->head = 0;
+
+  return 0;
+}
+
+void rt_msgq_send(rt_msgq_t *msgq, const void *msg)
+{
+  int irq = hal_irq_disable();
+  // The message is copied by the receiver which frees a slot, so there is nothing
+  // to do once the thread is woken-up
+  if (__rt_msgq_send(msgq, msg)) __rt_thread_wait(&msgq->senders, (void *)msg);
+  hal_irq_restore(irq);
+}
+
+int rt_msgq_try_send(rt_msgq_t *msgq, const void *msg)
+{
+  int irq = hal_irq_disable();
+  int result = __rt_msgq_send(msgq, msg);
+  hal_irq_restore(irq);
+  return result;
+}
+
+void rt_msgq_receive(rt_msgq_t *msgq, void *msg)
+{
+  int irq = hal_irq_disable();
+  // The message is directly copied by the sender, so there is nothing to do once
+  // the thread is woken-up
+  if (__rt_msgq_receive(msgq, msg)) __rt_thread_wait(&msgq->receivers, msg);
+  hal_irq_restore(irq);
+}
+
+int rt_msgq_try_receive(rt_msgq_t *msgq, void *msg)
+{
+  int irq = hal_irq_disable();
+  int result = __rt_msgq_receive(msgq, msg);
+  hal_irq_restore(irq);
+  return result;
+}
+
 RT_BOOT_CODE void __attribute__((constructor)) __rt_thread_sched_init()
 {
-  __rt_thread_queue_init(&__rt_ready_queue);
+  __rt_thread_ready_queue_init(&__rt_ready_queue);
   __rt_thread_init(&__rt_thread_main, NULL, NULL, 0, 0);
   __rt_thread_current = &__rt_thread_main;
+#if defined(ARCHI_HAS_FC)
+  __rt_init_event(&__rt_thread_slice_event, NULL, __rt_thread_slice_handler, NULL);
+#endif
 }
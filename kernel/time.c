@@ -22,8 +22,272 @@
 
 #if defined(ARCHI_HAS_FC)
 
+// The delayed events are stored in a hashed timer wheel. Each slot contains the
+// events whose deadline falls into a window of 1<<RT_TIMER_WHEEL_SLOT_LOG2 timer ticks,
+// and the wheel wraps around every RT_TIMER_WHEEL_NB_SLOTS slots, so that a slot can
+// contain events from several rounds. Slots are not sorted.
+// Deadlines are kept as 32 bits timer ticks and compared with wrap-around arithmetic.
+#ifndef RT_TIMER_WHEEL_NB_SLOTS
+#define RT_TIMER_WHEEL_NB_SLOTS 16
+#endif
+
+#ifndef RT_TIMER_WHEEL_SLOT_LOG2
+#define RT_TIMER_WHEEL_SLOT_LOG2 5
+#endif
+
 static unsigned long long timer_count;
 
+static rt_event_t *__rt_timer_wheel[RT_TIMER_WHEEL_NB_SLOTS];
+static int __rt_timer_nb_events;
+// Time at which the wheel was last processed, slots are scanned from this one
+static unsigned int __rt_timer_current;
+// Deadline for which the timer comparator is currently programmed
+static unsigned int __rt_timer_next;
+
+extern void __rt_timer_handler();
+
+
+
+static inline unsigned int __rt_timer_ticks()
+{
+  return (unsigned int)hal_timer_count_get_64(hal_timer_fc_addr(0, 0));
+}
+
+static inline int __rt_timer_slot(unsigned int time)
+{
+  return (time >> RT_TIMER_WHEEL_SLOT_LOG2) & (RT_TIMER_WHEEL_NB_SLOTS - 1);
+}
+
+static unsigned int __rt_timer_us_to_ticks(unsigned int us)
+{
+  // Round up so that an event is never executed before its deadline
+  return ((unsigned long long)us * ARCHI_REF_CLOCK + 999999) / 1000000;
+}
+
+static void __rt_timer_insert(rt_event_t *event)
+{
+  int slot = __rt_timer_slot(event->timer.time);
+  event->timer.next = __rt_timer_wheel[slot];
+  __rt_timer_wheel[slot] = event;
+  __rt_timer_nb_events++;
+}
+
+static int __rt_timer_remove(rt_event_t *event)
+{
+  rt_event_t **prev = &__rt_timer_wheel[__rt_timer_slot(event->timer.time)];
+  while (*prev)
+  {
+    if (*prev == event)
+    {
+      *prev = event->timer.next;
+      __rt_timer_nb_events--;
+      return 0;
+    }
+    prev = &(*prev)->timer.next;
+  }
+  return -1;
+}
+
+static void __rt_timer_fire(rt_event_t *event)
+{
+  // Internal events without scheduler are directly executed from the interrupt handler
+  if (event->sched == NULL)
+  {
+    event->callback(event->arg);
+    return;
+  }
+
+  if (event->timer.period)
+  {
+    // Periodic events are kept pending while they are in the scheduler so that they
+    // are not released after their execution. If the previous occurrence is still waiting
+    // to be executed, this one is dropped.
+    if (event->pending) return;
+    event->pending = 1;
+  }
+  rt_event_push(event);
+}
+
+// Push to their scheduler all the events whose deadline is reached
+static void __rt_timer_expire(unsigned int now)
+{
+  rt_event_t *periodic = NULL;
+  int nb_slots = RT_TIMER_WHEEL_NB_SLOTS;
+  unsigned int elapsed = (now >> RT_TIMER_WHEEL_SLOT_LOG2) - (__rt_timer_current >> RT_TIMER_WHEEL_SLOT_LOG2);
+
+  if (elapsed < RT_TIMER_WHEEL_NB_SLOTS) nb_slots = elapsed + 1;
+
+  int slot = __rt_timer_slot(__rt_timer_current);
+  for (int i=0; i<nb_slots; i++)
+  {
+    rt_event_t **prev = &__rt_timer_wheel[slot];
+    while (*prev)
+    {
+      rt_event_t *event = *prev;
+      if ((int)(event->timer.time - now) <= 0)
+      {
+        *prev = event->timer.next;
+        __rt_timer_nb_events--;
+
+        // Periodic events are put aside and inserted again once the wheel has been
+        // scanned, as they could land in a slot which remains to be scanned
+        if (event->timer.period)
+        {
+          event->timer.next = periodic;
+          periodic = event;
+        }
+
+        __rt_timer_fire(event);
+      }
+      else
+      {
+        prev = &event->timer.next;
+      }
+    }
+    slot = (slot + 1) & (RT_TIMER_WHEEL_NB_SLOTS - 1);
+  }
+
+  __rt_timer_current = now;
+
+  while (periodic)
+  {
+    rt_event_t *next = periodic->timer.next;
+    periodic->timer.time += periodic->timer.period;
+    // Don't try to catch up with the missed periods, this would just flood the scheduler
+    if ((int)(periodic->timer.time - now) <= 0) periodic->timer.time = now + periodic->timer.period;
+    __rt_timer_insert(periodic);
+    periodic = next;
+  }
+}
+
+// Return the nearest deadline. The wheel is scanned from the current slot, the first slot
+// containing an event for the current round gives the nearest deadline. Only if no such event
+// is found, all the events are checked.
+static unsigned int __rt_timer_get_next(unsigned int now)
+{
+  int slot = __rt_timer_slot(now);
+  unsigned int round = now >> RT_TIMER_WHEEL_SLOT_LOG2;
+  unsigned int min = 0xffffffff;
+  int found = 0;
+
+  for (int i=0; i<RT_TIMER_WHEEL_NB_SLOTS; i++)
+  {
+    for (rt_event_t *event = __rt_timer_wheel[slot]; event; event=event->timer.next)
+    {
+      if ((event->timer.time >> RT_TIMER_WHEEL_SLOT_LOG2) == round + i && event->timer.time - now < min)
+      {
+        min = event->timer.time - now;
+        found = 1;
+      }
+    }
+    if (found) return now + min;
+    slot = (slot + 1) & (RT_TIMER_WHEEL_NB_SLOTS - 1);
+  }
+
+  for (int i=0; i<RT_TIMER_WHEEL_NB_SLOTS; i++)
+  {
+    for (rt_event_t *event = __rt_timer_wheel[i]; event; event=event->timer.next)
+    {
+      if (event->timer.time - now < min) min = event->timer.time - now;
+    }
+  }
+
+  return now + min;
+}
+
+// Process the expired events and program the timer comparator for the nearest
+// remaining deadline. This must be called with interrupts disabled.
+static void __rt_timer_update()
+{
+  while(1)
+  {
+    __rt_timer_expire(__rt_timer_ticks());
+
+    if (__rt_timer_nb_events == 0)
+    {
+      hal_timer_cmp_set_64(hal_timer_fc_addr(0, 0), 0xffffffffffffffffULL);
+      return;
+    }
+
+    unsigned long long count = hal_timer_count_get_64(hal_timer_fc_addr(0, 0));
+    unsigned int next = __rt_timer_get_next((unsigned int)count);
+    __rt_timer_next = next;
+    hal_timer_cmp_set_64(hal_timer_fc_addr(0, 0), count + (int)(next - (unsigned int)count));
+
+    // The deadline may have been reached while the comparator was programmed, in which
+    // case the interrupt could be missed, so process the wheel again
+    if ((int)(next - __rt_timer_ticks()) > 0) return;
+  }
+}
+
+void __rt_timer_handle()
+{
+  __rt_timer_update();
+
+  // Now that the threads waiting for a deadline are ready, check if the current
+  // one must be preempted
+  __rt_thread_preempt();
+}
+
+static void __rt_timer_push(rt_event_t *event, unsigned int ticks, unsigned int period)
+{
+  int irq = hal_irq_disable();
+
+  event->timer.time = __rt_timer_ticks() + ticks;
+  event->timer.period = period;
+
+  // The comparator is only reprogrammed if the new event is the nearest one
+  int update = __rt_timer_nb_events == 0 || (int)(event->timer.time - __rt_timer_next) < 0;
+
+  // Make sure the wheel is scanned from a time before this deadline
+  if (__rt_timer_nb_events == 0) __rt_timer_current = event->timer.time - ticks;
+
+  __rt_timer_insert(event);
+
+  if (update) __rt_timer_update();
+
+  hal_irq_restore(irq);
+}
+
+void rt_event_push_delayed(rt_event_t *event, int us)
+{
+  __rt_timer_push(event, __rt_timer_us_to_ticks(us), 0);
+}
+
+void rt_event_push_periodic(rt_event_t *event, int period_us)
+{
+  unsigned int period = __rt_timer_us_to_ticks(period_us);
+  if (period == 0) period = 1;
+  __rt_timer_push(event, period, period);
+}
+
+int rt_event_cancel_delayed(rt_event_t *event)
+{
+  int irq = hal_irq_disable();
+
+  if (__rt_timer_remove(event))
+  {
+    hal_irq_restore(irq);
+    return -1;
+  }
+
+  // The event is released. In case a periodic event is still waiting in the scheduler,
+  // or is being executed, e.g. when it is cancelled from its own callback, it is marked
+  // as cancelled and will be released after its execution.
+  if (event->timer.period && event->pending)
+  {
+    event->timer.period = 0;
+    event->pending = __RT_EVENT_PENDING_CANCELLED;
+  }
+  else if (event->sched)
+  {
+    __rt_event_release(event);
+  }
+
+  hal_irq_restore(irq);
+  return 0;
+}
+
 
 
 static int __rt_time_poweroff(void *arg)
@@ -40,9 +304,46 @@ static int __rt_time_poweron(void *arg)
   // Restore the timer count we saved before shutdown
   hal_timer_count_set_64(hal_timer_fc_addr(0, 0), timer_count);
 
+  // The deadlines are relative to the timer count so they are still valid, but the
+  // comparator must be programmed again
+  int irq = hal_irq_disable();
+  __rt_timer_update();
+  hal_irq_restore(irq);
+
   return 0;
 }
 
+void rt_event_execute_timeout(rt_event_sched_t *sched, int us)
+{
+  rt_event_t event;
+
+  if (sched == NULL) sched = __rt_thread_current->sched;
+
+  // The deadline is an event without callback kept on the stack. It is kept pending
+  // so that it is not released after its execution and the loop can check when it is
+  // over. Between events the core sleeps until the next interrupt, which is either
+  // an external one or the timer comparator.
+  __rt_init_internal_event(&event, sched, NULL, NULL);
+  __rt_event_set_pending(&event);
+
+  int irq = hal_irq_disable();
+
+  event.thread = __rt_thread_current;
+  rt_event_push_delayed(&event, us);
+
+  while (event.pending)
+  {
+    __rt_event_execute(sched, 1);
+  }
+
+  hal_irq_restore(irq);
+}
+
+void rt_time_wait_us(int us)
+{
+  rt_event_execute_timeout(NULL, us);
+}
+
 unsigned long long rt_time_get_us()
 {
   // Get 64 bit timer counter value and convert it to microseconds
@@ -56,16 +357,25 @@ RT_FC_BOOT_CODE void __attribute__((constructor)) __rt_time_init()
 {
   int err = 0;
 
+  // No delayed event yet, make sure the comparator never matches
+  hal_timer_cmp_set_64(hal_timer_fc_addr(0, 0), 0xffffffffffffffffULL);
+
   // Configure the FC timer in 64 bits mode as it will be used as a common
   // timer for all virtual timers.
   // We also use the ref clock to make the frequency stable.
   hal_timer_conf(
     hal_timer_fc_addr(0, 0), PLP_TIMER_ACTIVE, PLP_TIMER_RESET_ENABLED,
-    PLP_TIMER_IRQ_DISABLED, PLP_TIMER_IEM_DISABLED, PLP_TIMER_CMPCLR_DISABLED,
+    PLP_TIMER_IRQ_ENABLED, PLP_TIMER_IEM_DISABLED, PLP_TIMER_CMPCLR_DISABLED,
     PLP_TIMER_ONE_SHOT_DISABLED, PLP_TIMER_REFCLK_ENABLED,
     PLP_TIMER_PRESCALER_DISABLED, 0, PLP_TIMER_MODE_64_ENABLED
   );
 
+#if defined(__riscv__)
+  // The comparator is used to get an interrupt for the nearest delayed event
+  rt_irq_set_handler(ARCHI_FC_EVT_TIMER0_LO, __rt_timer_handler);
+  rt_irq_mask_set(1<<ARCHI_FC_EVT_TIMER0_LO);
+#endif
+
   err |= __rt_cbsys_add(RT_CBSYS_POWEROFF, __rt_time_poweroff, NULL);
 
   err |= __rt_cbsys_add(RT_CBSYS_POWERON, __rt_time_poweron, NULL);
@@ -0,0 +1,673 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Native stress test and benchmark of the runtime memory allocators.
+//
+// The allocator sources are compiled for the workstation against the stub
+// runtime API of the stub directory, and work on simulated memories mapped
+// in the first 2GB, as they store addresses in 32 bits words.
+//
+// A trace of allocations, aligned allocations, reallocations and frees is
+// either generated randomly or read from a file, and then replayed on the
+// chosen allocator. The random trace can also first fragment the heap with
+// long-lived chunks, to compare the allocators when there are many holes. Each chunk is filled with a pattern which is checked
+// when it is resized or freed, to detect overlapping chunks. Each call is
+// timed to report the average, 99th percentile and worst-case latencies.
+// On a workstation the worst case also includes interrupts and preemptions of
+// the process, so the percentile is usually the most representative.
+// The trace
+// format is one operation per line, where slot identifies a live chunk:
+//   a <slot> <size>
+//   A <slot> <size> <align>
+//   r <slot> <new size>
+//   f <slot>
+
+#include "rt/rt_api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#ifndef MAP_32BIT
+#define MAP_32BIT 0
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_CYCLES 1
+#endif
+
+#define BENCH_L2_SIZE        (4<<20)
+#define BENCH_HEAP_SIZE      (1<<20)
+#define BENCH_NB_SLOTS       256
+#define BENCH_NB_OPS         200000
+#define BENCH_MAX_SIZE       (32<<10)
+#define BENCH_SAMPLE_PERIOD  64
+
+void *__rt_host_l2_base;
+int __rt_host_l2_size;
+
+typedef struct {
+  char op;
+  int slot;
+  int size;
+  int align;
+} bench_op_t;
+
+typedef struct {
+  const char *name;
+  void *(*alloc)(int size);
+  void *(*alloc_align)(int size, int align);
+  void *(*realloc)(void *chunk, int old_size, int new_size);
+  void (*free)(void *chunk, int size);
+  void (*info)(int *size, int *nb_chunks);
+  void (*stats)(rt_alloc_stats_t *stats);
+} bench_alloc_t;
+
+typedef struct {
+  unsigned int nb;
+  unsigned int nb_fail;
+  unsigned long long ticks;
+  unsigned int *samples;
+} bench_timing_t;
+
+typedef struct {
+  char *chunk;
+  int size;
+} bench_slot_t;
+
+
+
+// Allocators under test, they all manage the same simulated heap
+
+static rt_alloc_t bench_user;
+static rt_extern_alloc_t bench_extern;
+static char *bench_heap;
+static int bench_heap_size = BENCH_HEAP_SIZE;
+
+static void *bench_user_alloc(int size) { return rt_user_alloc(&bench_user, size); }
+static void *bench_user_alloc_align(int size, int align) { return rt_user_alloc_align(&bench_user, size, align); }
+static void *bench_user_realloc(void *chunk, int old_size, int new_size) { return rt_user_realloc(&bench_user, chunk, old_size, new_size); }
+static void bench_user_free(void *chunk, int size) { rt_user_free(&bench_user, chunk, size); }
+static void bench_user_info(int *size, int *nb_chunks) { rt_user_alloc_info(&bench_user, size, NULL, nb_chunks); }
+static void bench_user_stats(rt_alloc_stats_t *stats) { rt_user_alloc_stats(&bench_user, stats); }
+
+static void *bench_extern_alloc(int size) { return rt_extern_alloc(&bench_extern, size); }
+static void *bench_extern_alloc_align(int size, int align) { return rt_extern_alloc_align(&bench_extern, size, align); }
+static void bench_extern_free(void *chunk, int size) { rt_extern_free(&bench_extern, chunk, size); }
+static void bench_extern_info(int *size, int *nb_chunks) { rt_extern_alloc_info(&bench_extern, size, NULL, nb_chunks); }
+static void bench_extern_stats(rt_alloc_stats_t *stats) { rt_extern_alloc_stats(&bench_extern, stats); }
+
+static bench_alloc_t bench_allocs[] = {
+#if defined(__RT_ALLOC_TLSF)
+  { "user (tlsf)", bench_user_alloc, bench_user_alloc_align, bench_user_realloc, bench_user_free, bench_user_info, bench_user_stats },
+#else
+  { "user (list)", bench_user_alloc, bench_user_alloc_align, bench_user_realloc, bench_user_free, bench_user_info, bench_user_stats },
+#endif
+#if defined(__RT_ALLOC_EXTERN_BUDDY)
+  { "extern (buddy)", bench_extern_alloc, bench_extern_alloc_align, NULL, bench_extern_free, bench_extern_info, bench_extern_stats },
+#else
+  { "extern (list)", bench_extern_alloc, bench_extern_alloc_align, NULL, bench_extern_free, bench_extern_info, bench_extern_stats },
+#endif
+};
+
+static void *bench_map(int size)
+{
+  void *result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+  if (result == MAP_FAILED) return NULL;
+  return result;
+}
+
+static int bench_init(int extern_alloc)
+{
+  // The L2 memory is used through rt_alloc by the allocators for their own data,
+  // like the extern allocator chunk descriptors
+  __rt_host_l2_size = BENCH_L2_SIZE;
+  __rt_host_l2_base = bench_map(__rt_host_l2_size);
+  bench_heap = bench_map(bench_heap_size);
+  if (__rt_host_l2_base == NULL || bench_heap == NULL) return -1;
+
+  // Touch the memories so that page faults are not measured as allocator latencies
+  memset(__rt_host_l2_base, 0, __rt_host_l2_size);
+  memset(bench_heap, 0, bench_heap_size);
+
+  __rt_allocs_init();
+
+  if (extern_alloc) return rt_extern_alloc_init(&bench_extern, bench_heap, bench_heap_size);
+
+  rt_user_alloc_init(&bench_user, bench_heap, bench_heap_size);
+  return 0;
+}
+
+
+
+// Trace generation and parsing
+
+static unsigned int bench_seed = 1;
+
+static unsigned int bench_rand()
+{
+  // Xorshift so that the same seed gives the same trace on any host
+  bench_seed ^= bench_seed << 13;
+  bench_seed ^= bench_seed >> 17;
+  bench_seed ^= bench_seed << 5;
+  return bench_seed;
+}
+
+static int bench_rand_size(int max_size)
+{
+  // Mostly small descriptors, some buffers and a few big ones
+  unsigned int kind = bench_rand() % 100;
+  int size;
+  if (kind < 70) size = 8 + bench_rand() % 248;
+  else if (kind < 95) size = 256 + bench_rand() % 3840;
+  else size = 4096 + bench_rand() % max_size;
+  return size > max_size ? max_size : size;
+}
+
+static void bench_trace_gen_op(bench_op_t *op, int slot, char *used, int max_size)
+{
+  op->slot = slot;
+  op->align = 0;
+
+  if (!used[slot])
+  {
+    op->size = bench_rand_size(max_size);
+    if (bench_rand() % 8 == 0) {
+      op->op = 'A';
+      op->align = 16 << (bench_rand() % 5);
+    } else {
+      op->op = 'a';
+    }
+    used[slot] = 1;
+  }
+  else if (bench_rand() % 4 == 0)
+  {
+    op->op = 'r';
+    op->size = bench_rand_size(max_size);
+  }
+  else
+  {
+    op->op = 'f';
+    op->size = 0;
+    used[slot] = 0;
+  }
+}
+
+static bench_op_t *bench_trace_gen(int nb_ops, int nb_slots, int max_size, int frag)
+{
+  bench_op_t *trace = malloc(sizeof(bench_op_t) * nb_ops);
+  char *used = calloc(nb_slots, 1);
+  int nb = 0;
+  if (trace == NULL || used == NULL) return NULL;
+
+  if (frag)
+  {
+    // Small long-lived chunks in even slots are interleaved with bigger chunks in odd
+    // slots, which are then freed so that the free memory is split into holes. The
+    // rest of the trace only uses odd slots and keeps the long-lived chunks until the end.
+    for (int i=0; i<nb_slots && nb<nb_ops; i++)
+    {
+      bench_op_t *op = &trace[nb++];
+      op->op = 'a';
+      op->slot = i;
+      op->size = i & 1 ? bench_rand_size(max_size) : 8 + bench_rand() % 56;
+      op->align = 0;
+      used[i] = 1;
+    }
+
+    for (int i=1; i<nb_slots && nb<nb_ops; i+=2)
+    {
+      bench_op_t *op = &trace[nb++];
+      op->op = 'f';
+      op->slot = i;
+      op->size = 0;
+      op->align = 0;
+      used[i] = 0;
+    }
+
+    for (; nb<nb_ops; nb++)
+    {
+      bench_trace_gen_op(&trace[nb], (bench_rand() % (nb_slots / 2)) * 2 + 1, used, max_size);
+    }
+  }
+  else
+  {
+    for (; nb<nb_ops; nb++)
+    {
+      bench_trace_gen_op(&trace[nb], bench_rand() % nb_slots, used, max_size);
+    }
+  }
+
+  free(used);
+  return trace;
+}
+
+static int bench_trace_write(const char *path, bench_op_t *trace, int nb_ops)
+{
+  FILE *file = fopen(path, "w");
+  if (file == NULL) return -1;
+
+  fprintf(file, "# seed %u\n", bench_seed);
+  for (int i=0; i<nb_ops; i++)
+  {
+    bench_op_t *op = &trace[i];
+    switch (op->op)
+    {
+      case 'a': fprintf(file, "a %d %d\n", op->slot, op->size); break;
+      case 'A': fprintf(file, "A %d %d %d\n", op->slot, op->size, op->align); break;
+      case 'r': fprintf(file, "r %d %d\n", op->slot, op->size); break;
+      case 'f': fprintf(file, "f %d\n", op->slot); break;
+    }
+  }
+
+  fclose(file);
+  return 0;
+}
+
+static bench_op_t *bench_trace_read(const char *path, int *nb_ops, int *nb_slots)
+{
+  FILE *file = fopen(path, "r");
+  if (file == NULL) return NULL;
+
+  int size = 1024;
+  bench_op_t *trace = malloc(sizeof(bench_op_t) * size);
+  char line[128];
+  int nb = 0;
+
+  *nb_slots = 0;
+
+  while (trace && fgets(line, sizeof(line), file))
+  {
+    bench_op_t op = { 0, 0, 0, 0 };
+
+    if (line[0] == '#' || line[0] == '\n') continue;
+
+    int nb_fields = sscanf(line, "%c %d %d %d", &op.op, &op.slot, &op.size, &op.align);
+    if (nb_fields < 2 || strchr("aArf", op.op) == NULL || op.slot < 0 || (op.op != 'f' && (nb_fields < 3 || op.size <= 0)) ||
+      (op.op == 'A' && (nb_fields < 4 || op.align <= 0 || (op.align & (op.align - 1)))))
+    {
+      fprintf(stderr, "Invalid trace line: %s", line);
+      free(trace);
+      trace = NULL;
+      break;
+    }
+
+    if (op.slot >= *nb_slots) *nb_slots = op.slot + 1;
+
+    if (nb == size) {
+      size *= 2;
+      trace = realloc(trace, sizeof(bench_op_t) * size);
+      if (trace == NULL) break;
+    }
+    trace[nb++] = op;
+  }
+
+  fclose(file);
+  *nb_ops = nb;
+  return trace;
+}
+
+
+
+// Replay
+
+static inline unsigned long long bench_time()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Calls are timed with the cycle counter when there is one, otherwise with the clock
+static inline unsigned long long bench_ticks()
+{
+#if defined(BENCH_HAS_CYCLES)
+  return __rdtsc();
+#else
+  return bench_time();
+#endif
+}
+
+static unsigned long long bench_ticks_overhead;
+static double bench_ticks_per_ns = 1.0;
+
+static void bench_calibrate()
+{
+  // Cost of timing an empty call, removed from all measures
+  bench_ticks_overhead = ~0ULL;
+  for (int i=0; i<1000; i++)
+  {
+    unsigned long long start = bench_ticks();
+    unsigned long long ticks = bench_ticks() - start;
+    if (ticks < bench_ticks_overhead) bench_ticks_overhead = ticks;
+  }
+
+#if defined(BENCH_HAS_CYCLES)
+  unsigned long long time = bench_time(), ticks = bench_ticks();
+  while (bench_time() - time < 20000000);
+  bench_ticks_per_ns = (double)(bench_ticks() - ticks) / (bench_time() - time);
+#endif
+}
+
+#define BENCH_TIMED(timing, code)                                    \
+  do {                                                               \
+    unsigned long long __ticks = bench_ticks();                      \
+    code;                                                            \
+    __ticks = bench_ticks() - __ticks;                               \
+    (timing)->ticks += __ticks;                                      \
+    (timing)->samples[(timing)->nb++] = __ticks;                     \
+  } while(0)
+
+static int bench_sample_cmp(const void *a, const void *b)
+{
+  unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+  return x < y ? -1 : x > y;
+}
+
+static inline double bench_sample_ticks(unsigned int ticks)
+{
+  return ticks > bench_ticks_overhead ? (double)(ticks - bench_ticks_overhead) : 0.0;
+}
+
+static void bench_timing_print(const char *name, bench_timing_t *t)
+{
+  if (t->nb == 0) return;
+
+  qsort(t->samples, t->nb, sizeof(unsigned int), bench_sample_cmp);
+
+  double avg = (double)t->ticks / t->nb - bench_ticks_overhead;
+  double p99 = bench_sample_ticks(t->samples[(t->nb - 1) * 99ULL / 100]);
+  double max = bench_sample_ticks(t->samples[t->nb - 1]);
+
+  printf("  %-12s %8u calls %8u failed, ns: %8.1f avg %8.1f p99 %8.1f max", name, t->nb, t->nb_fail,
+    avg / bench_ticks_per_ns, p99 / bench_ticks_per_ns, max / bench_ticks_per_ns);
+#if defined(BENCH_HAS_CYCLES)
+  printf(", cycles: %8.1f avg %8.1f p99 %8.1f max", avg, p99, max);
+#endif
+  printf("\n");
+}
+
+static inline char bench_pattern(int slot, int index)
+{
+  return (char)(slot * 7 + index);
+}
+
+static void bench_fill(bench_slot_t *slot, int id, int from)
+{
+  for (int i=from; i<slot->size; i++) slot->chunk[i] = bench_pattern(id, i);
+}
+
+static int bench_check(bench_slot_t *slot, int id, int size)
+{
+  for (int i=0; i<size; i++)
+  {
+    if (slot->chunk[i] != bench_pattern(id, i))
+    {
+      fprintf(stderr, "Chunk corrupted (slot: %d, chunk: %p, size: %d, offset: %d)\n", id, slot->chunk, slot->size, i);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int bench_check_chunk(bench_op_t *op, char *chunk, int size, int align)
+{
+  if (chunk < bench_heap || chunk + size > bench_heap + bench_heap_size)
+  {
+    fprintf(stderr, "Chunk out of heap (op: %c, slot: %d, chunk: %p, size: %d)\n", op->op, op->slot, chunk, size);
+    return -1;
+  }
+
+  if (align && ((unsigned long)chunk & (align - 1)))
+  {
+    fprintf(stderr, "Misaligned chunk (slot: %d, chunk: %p, align: %d)\n", op->slot, chunk, align);
+    return -1;
+  }
+
+  return 0;
+}
+
+static int bench_replay(bench_alloc_t *alloc, bench_op_t *trace, int nb_ops, int nb_slots)
+{
+  bench_slot_t *slots = calloc(nb_slots, sizeof(bench_slot_t));
+  bench_timing_t t_alloc = { 0 }, t_align = { 0 }, t_realloc = { 0 }, t_free = { 0 };
+  int init_free, init_chunks, free_size, nb_chunks;
+  double frag_sum = 0, frag_worst = 0;
+  int nb_samples = 0, max_chunks = 0, errors = 0;
+
+  bench_timing_t *timings[] = { &t_alloc, &t_align, &t_realloc, &t_free };
+  const char *names[] = { "alloc", "alloc_align", "realloc", "free" };
+
+  if (slots == NULL) return -1;
+
+  // Each call of the trace plus the final frees may be timed by the same timing
+  for (int i=0; i<4; i++)
+  {
+    timings[i]->samples = malloc(sizeof(unsigned int) * (nb_ops + nb_slots));
+    if (timings[i]->samples == NULL) return -1;
+  }
+
+  alloc->info(&init_free, &init_chunks);
+
+  for (int i=0; i<nb_ops && !errors; i++)
+  {
+    bench_op_t *op = &trace[i];
+    bench_slot_t *slot = &slots[op->slot];
+
+    if (op->op == 'a' || op->op == 'A')
+    {
+      // Allocating a live slot is a trace error, just ignore it
+      if (slot->chunk) continue;
+
+      char *chunk;
+      if (op->op == 'a') {
+        BENCH_TIMED(&t_alloc, chunk = alloc->alloc(op->size));
+        if (chunk == NULL) t_alloc.nb_fail++;
+      } else {
+        BENCH_TIMED(&t_align, chunk = alloc->alloc_align(op->size, op->align));
+        if (chunk == NULL) t_align.nb_fail++;
+      }
+
+      if (chunk == NULL) continue;
+      if (bench_check_chunk(op, chunk, op->size, op->align)) errors++;
+
+      slot->chunk = chunk;
+      slot->size = op->size;
+      bench_fill(slot, op->slot, 0);
+    }
+    else if (op->op == 'r')
+    {
+      if (slot->chunk == NULL) continue;
+
+      int keep = op->size < slot->size ? op->size : slot->size;
+      char *chunk;
+
+      if (alloc->realloc) {
+        BENCH_TIMED(&t_realloc, chunk = alloc->realloc(slot->chunk, slot->size, op->size));
+      } else {
+        // Allocators without resize support are given the equivalent sequence
+        BENCH_TIMED(&t_realloc,
+          chunk = alloc->alloc(op->size);
+          if (chunk) {
+            memcpy(chunk, slot->chunk, keep);
+            alloc->free(slot->chunk, slot->size);
+          }
+        );
+      }
+
+      if (chunk == NULL) {
+        t_realloc.nb_fail++;
+        continue;
+      }
+      if (bench_check_chunk(op, chunk, op->size, 0)) errors++;
+
+      slot->chunk = chunk;
+      if (bench_check(slot, op->slot, keep)) errors++;
+      slot->size = op->size;
+      bench_fill(slot, op->slot, keep);
+    }
+    else if (op->op == 'f')
+    {
+      if (slot->chunk == NULL) continue;
+      if (bench_check(slot, op->slot, slot->size)) errors++;
+      BENCH_TIMED(&t_free, alloc->free(slot->chunk, slot->size));
+      slot->chunk = NULL;
+    }
+
+    // Fragmentation is the part of the free memory which can not be used for
+    // an allocation of the size of the largest free block
+    if (i % BENCH_SAMPLE_PERIOD == 0)
+    {
+      rt_alloc_stats_t stats;
+      alloc->info(&free_size, &nb_chunks);
+      alloc->stats(&stats);
+      if (free_size > 0)
+      {
+        double frag = 1.0 - (double)stats.largest_free / free_size;
+        frag_sum += frag;
+        if (frag > frag_worst) frag_worst = frag;
+        nb_samples++;
+      }
+      if (nb_chunks > max_chunks) max_chunks = nb_chunks;
+    }
+  }
+
+  rt_alloc_stats_t stats;
+  alloc->stats(&stats);
+
+  // Release everything, the allocator must then get back its initial free memory
+  for (int i=0; i<nb_slots; i++)
+  {
+    bench_slot_t *slot = &slots[i];
+    if (slot->chunk == NULL) continue;
+    if (bench_check(slot, i, slot->size)) errors++;
+    BENCH_TIMED(&t_free, alloc->free(slot->chunk, slot->size));
+  }
+
+  alloc->info(&free_size, &nb_chunks);
+  if (free_size != init_free)
+  {
+    fprintf(stderr, "Memory leak (initial free: %d, final free: %d)\n", init_free, free_size);
+    errors++;
+  }
+
+  printf("allocator: %s, heap: %d bytes, operations: %d\n", alloc->name, bench_heap_size, nb_ops);
+  for (int i=0; i<4; i++)
+  {
+    bench_timing_print(names[i], timings[i]);
+  }
+  printf("  peak usage:    %u bytes (%.1f %% of heap)\n", stats.peak, 100.0 * stats.peak / bench_heap_size);
+  printf("  fragmentation: %.1f %% average, %.1f %% worst, %d free chunks at most\n",
+    nb_samples ? 100.0 * frag_sum / nb_samples : 0.0, 100.0 * frag_worst, max_chunks);
+  printf("  after release: %d free bytes in %d chunks (initially %d in %d)\n", free_size, nb_chunks, init_free, init_chunks);
+
+  printf("  %s\n", errors ? "FAILED" : "OK");
+
+  for (int i=0; i<4; i++)
+  {
+    free(timings[i]->samples);
+  }
+  free(slots);
+  return errors ? -1 : 0;
+}
+
+
+
+static void bench_usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [options]\n", name);
+  fprintf(stderr, "  -e          Test the extern allocator instead of the user allocator\n");
+  fprintf(stderr, "  -s <seed>   Seed of the random trace (default: 1)\n");
+  fprintf(stderr, "  -f          Fragment the heap with long-lived chunks at the beginning of the random trace\n");
+  fprintf(stderr, "  -n <ops>    Number of operations of the random trace (default: %d)\n", BENCH_NB_OPS);
+  fprintf(stderr, "  -l <slots>  Maximum number of live chunks of the random trace (default: %d)\n", BENCH_NB_SLOTS);
+  fprintf(stderr, "  -m <size>   Maximum chunk size of the random trace (default: %d)\n", BENCH_MAX_SIZE);
+  fprintf(stderr, "  -H <size>   Size of the simulated heap (default: %d)\n", BENCH_HEAP_SIZE);
+  fprintf(stderr, "  -w <file>   Write the random trace to the file\n");
+  fprintf(stderr, "  -r <file>   Replay the trace of the file instead of a random one\n");
+}
+
+int main(int argc, char *argv[])
+{
+  int extern_alloc = 0;
+  int nb_ops = BENCH_NB_OPS;
+  int nb_slots = BENCH_NB_SLOTS;
+  int max_size = BENCH_MAX_SIZE;
+  int frag = 0;
+  const char *write_path = NULL;
+  const char *read_path = NULL;
+  bench_op_t *trace;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "es:fn:l:m:H:w:r:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'e': extern_alloc = 1; break;
+      case 's': bench_seed = strtoul(optarg, NULL, 0); break;
+      case 'f': frag = 1; break;
+      case 'n': nb_ops = atoi(optarg); break;
+      case 'l': nb_slots = atoi(optarg); break;
+      case 'm': max_size = atoi(optarg); break;
+      case 'H': bench_heap_size = atoi(optarg); break;
+      case 'w': write_path = optarg; break;
+      case 'r': read_path = optarg; break;
+      default: bench_usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if (bench_seed == 0 || nb_ops <= 0 || nb_slots <= 0 || max_size <= 0 || bench_heap_size <= 0 || (frag && nb_slots < 2))
+  {
+    bench_usage(argv[0]);
+    return 1;
+  }
+
+  if (read_path)
+  {
+    trace = bench_trace_read(read_path, &nb_ops, &nb_slots);
+    if (trace == NULL) {
+      fprintf(stderr, "Failed to read trace: %s\n", read_path);
+      return 1;
+    }
+  }
+  else
+  {
+    unsigned int seed = bench_seed;
+    trace = bench_trace_gen(nb_ops, nb_slots, max_size, frag);
+    if (trace == NULL) return 1;
+    bench_seed = seed;
+    if (write_path && bench_trace_write(write_path, trace, nb_ops)) {
+      fprintf(stderr, "Failed to write trace: %s\n", write_path);
+      return 1;
+    }
+  }
+
+  if (bench_init(extern_alloc))
+  {
+    fprintf(stderr, "Failed to initialize simulated memories\n");
+    return 1;
+  }
+
+  bench_calibrate();
+
+  int err = bench_replay(&bench_allocs[extern_alloc], trace, nb_ops, nb_slots);
+
+  free(trace);
+  return err ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measure the bandwidth of uDMA and cluster DMA transfers running at the same
+// time on two L2 buffers, first allocated with rt_alloc and then with placement
+// hints. Without hint both buffers are taken from the same L2 bank, so the two
+// masters conflict on it. With hints the uDMA buffer goes to a private bank and
+// the cluster DMA buffer to the shared banks.
+// The uDMA traffic is generated with HyperRAM reads, so the platform must have
+// a HyperRAM device.
+
+#include "rt/rt_api.h"
+#include <stdio.h>
+
+#define BUFFER_SIZE 16384
+#define NB_ITER     16
+
+static rt_hyperram_t *hyper;
+static char *l1_buffer;
+static char *cl_buffer;
+static int udma_pending;
+static unsigned long long udma_end;
+static unsigned long long cl_end;
+static int cl_done;
+
+static void handle_udma_end(void *arg)
+{
+  if (--udma_pending == 0) udma_end = rt_time_get_us();
+}
+
+static void handle_cl_end(void *arg)
+{
+  cl_end = rt_time_get_us();
+  cl_done = 1;
+}
+
+static void cluster_entry(void *arg)
+{
+  rt_dma_copy_t copy;
+  for (int i=0; i<NB_ITER; i++)
+  {
+    rt_dma_memcpy((unsigned int)cl_buffer, (unsigned int)l1_buffer, BUFFER_SIZE, RT_DMA_DIR_EXT2LOC, 0, &copy);
+    rt_dma_wait(&copy);
+  }
+}
+
+static int bench(const char *name, char *udma_buffer)
+{
+  if (udma_buffer == NULL || cl_buffer == NULL)
+  {
+    printf("Failed to allocate buffers\n");
+    return -1;
+  }
+
+  udma_pending = NB_ITER;
+  cl_done = 0;
+  unsigned long long start = rt_time_get_us();
+
+  // Both masters are started together, all the HyperRAM reads are enqueued at once
+  // to keep the uDMA busy during the whole cluster execution
+  if (rt_cluster_call(NULL, 0, cluster_entry, NULL, NULL, 0, 0, 1, rt_event_get(NULL, handle_cl_end, NULL)))
+    return -1;
+
+  for (int i=0; i<NB_ITER; i++)
+  {
+    rt_hyperram_read(hyper, udma_buffer, NULL, BUFFER_SIZE, rt_event_get(NULL, handle_udma_end, NULL));
+  }
+
+  while (udma_pending || !cl_done)
+  {
+    rt_event_execute(NULL, 1);
+  }
+
+  int udma_time = udma_end - start;
+  int cl_time = cl_end - start;
+
+  printf("%-8s uDMA buffer: %p, cluster DMA buffer: %p\n", name, udma_buffer, cl_buffer);
+  printf("%-8s uDMA: %d bytes in %d us (%d KB/s), cluster DMA: %d bytes in %d us (%d KB/s)\n", name,
+    NB_ITER*BUFFER_SIZE, udma_time, udma_time ? NB_ITER*BUFFER_SIZE*1000/1024/udma_time : 0,
+    NB_ITER*BUFFER_SIZE, cl_time, cl_time ? NB_ITER*BUFFER_SIZE*1000/1024/cl_time : 0);
+
+  return 0;
+}
+
+#if defined(__RT_ALLOC_L2_MULTI)
+static int get_bank(void *buffer)
+{
+  if ((char *)buffer >= (char *)rt_l2_priv0_base() && (char *)buffer < (char *)rt_l2_priv0_base() + rt_l2_priv0_size()) return 0;
+  if ((char *)buffer >= (char *)rt_l2_priv1_base() && (char *)buffer < (char *)rt_l2_priv1_base() + rt_l2_priv1_size()) return 1;
+  return 2;
+}
+#endif
+
+int main()
+{
+  int errors = 0;
+
+  if (rt_event_alloc(NULL, NB_ITER + 4)) return -1;
+
+  hyper = rt_hyperram_open("hyperram", NULL, NULL);
+  if (hyper == NULL)
+  {
+    printf("Failed to open HyperRAM\n");
+    return -1;
+  }
+
+  rt_cluster_mount(1, 0, 0, NULL);
+
+  l1_buffer = rt_alloc(RT_ALLOC_CL_DATA, BUFFER_SIZE);
+  if (l1_buffer == NULL) return -1;
+
+  // Without hint
+  char *udma_buffer = rt_alloc(RT_ALLOC_L2_CL_DATA, BUFFER_SIZE);
+  cl_buffer = rt_alloc(RT_ALLOC_L2_CL_DATA, BUFFER_SIZE);
+  if (bench("default", udma_buffer)) errors++;
+  if (udma_buffer) rt_free(RT_ALLOC_L2_CL_DATA, udma_buffer, BUFFER_SIZE);
+  if (cl_buffer) rt_free(RT_ALLOC_L2_CL_DATA, cl_buffer, BUFFER_SIZE);
+
+  // With hints
+  udma_buffer = rt_alloc_hint(RT_ALLOC_L2_CL_DATA, BUFFER_SIZE, RT_ALLOC_HINT_UDMA, NULL);
+  cl_buffer = rt_alloc_hint(RT_ALLOC_L2_CL_DATA, BUFFER_SIZE, RT_ALLOC_HINT_CL_DMA, NULL);
+  if (bench("hints", udma_buffer)) errors++;
+
+#if defined(__RT_ALLOC_L2_MULTI)
+  if (udma_buffer && cl_buffer && get_bank(udma_buffer) == get_bank(cl_buffer))
+  {
+    printf("Hinted buffers allocated in the same bank\n");
+    errors++;
+  }
+#else
+  printf("Single L2 allocator, the hints are ignored\n");
+#endif
+
+  if (udma_buffer) rt_free(RT_ALLOC_L2_CL_DATA, udma_buffer, BUFFER_SIZE);
+  if (cl_buffer) rt_free(RT_ALLOC_L2_CL_DATA, cl_buffer, BUFFER_SIZE);
+
+  rt_free(RT_ALLOC_CL_DATA, l1_buffer, BUFFER_SIZE);
+  rt_cluster_mount(0, 0, 0, NULL);
+  rt_hyperram_close(hyper, NULL);
+
+  printf("Test %s\n", errors ? "failure" : "success");
+
+  return errors ? -1 : 0;
+}
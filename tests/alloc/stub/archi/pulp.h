@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host stub of the architecture description, only declaring a single L2 memory,
+// which is the simulated heap used by rt_alloc.
+
+#ifndef __ARCHI_PULP_H__
+#define __ARCHI_PULP_H__
+
+#define CHIP_GAP   1
+#define PULP_CHIP  0
+
+#define ARCHI_HAS_L2 1
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RT_RT_API_H__
+#define __RT_RT_API_H__
+
+// Host stub of the runtime API, providing to the allocators the few runtime
+// services they use, so that they can be compiled natively.
+
+#include <stdint.h>
+
+// Free blocks hold pointers in their header, which need bigger granules than
+// on the target when the host has 64 bits pointers
+#if __SIZEOF_POINTER__ > 4
+#define RT_ALLOC_MIN_CHUNK_SIZE    16
+#define RT_ALLOC_TLSF_GRANULE_LOG2 5
+#endif
+
+#include "rt/rt_data.h"
+
+#define rt_trace(x...)            \
+  do {                            \
+  } while(0)
+
+static inline int __FL1(unsigned int x) { return 31 - __builtin_clz(x); }
+
+static inline int __FF1(unsigned int x) { return __builtin_ctz(x); }
+
+static inline int hal_irq_disable() { return 0; }
+
+static inline void hal_irq_restore(int irq) { }
+
+// Simulated L2 memory, which is where rt_alloc takes memory from
+extern void *__rt_host_l2_base;
+extern int __rt_host_l2_size;
+
+static inline void *rt_l2_base() { return __rt_host_l2_base; }
+
+static inline int rt_l2_size() { return __rt_host_l2_size; }
+
+#include "rt/rt_extern_alloc.h"
+#include "rt/rt_alloc.h"
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Check that a periodic event cancelled from its own callback is given back
+// to the free list, and is not executed anymore. Then check the same for a
+// periodic event cancelled while it is waiting in the scheduler, whose callback
+// must not be executed.
+
+#include "rt/rt_api.h"
+#include <stdio.h>
+
+#define NB_PERIODS 4
+#define PERIOD_US  1000
+
+static rt_event_t *periodic;
+static int count;
+static int queued_count;
+static int cancel_error;
+
+static void handle_period(void *arg)
+{
+  count++;
+  if (count == NB_PERIODS)
+  {
+    if (rt_event_cancel_delayed(periodic)) cancel_error = 1;
+  }
+}
+
+static void handle_queued(void *arg)
+{
+  queued_count++;
+}
+
+int main()
+{
+  rt_event_stats_t before, after;
+  int errors = 0;
+
+  if (rt_event_alloc(NULL, 4)) return -1;
+
+  rt_event_stats(&before);
+
+  periodic = rt_event_get(NULL, handle_period, NULL);
+  if (periodic == NULL) return -1;
+
+  rt_event_push_periodic(periodic, PERIOD_US);
+
+  while (count < NB_PERIODS)
+  {
+    rt_event_execute(NULL, 1);
+  }
+
+  // Let a few more periods elapse to check that the event is not pushed anymore
+  rt_time_wait_us(PERIOD_US * 4);
+  rt_event_execute(NULL, 0);
+
+  // Busy wait so that the event is pushed to the scheduler but not executed
+  rt_event_t *queued = rt_event_get(NULL, handle_queued, NULL);
+  if (queued == NULL) return -1;
+
+  rt_event_push_periodic(queued, PERIOD_US);
+
+  unsigned long long start = rt_time_get_us();
+  while (rt_time_get_us() - start < PERIOD_US * 2);
+
+  if (rt_event_cancel_delayed(queued)) cancel_error = 1;
+
+  rt_time_wait_us(PERIOD_US * 4);
+  rt_event_execute(NULL, 0);
+
+  rt_event_stats(&after);
+
+  if (cancel_error)
+  {
+    printf("Periodic event could not be cancelled\n");
+    errors++;
+  }
+
+  if (count != NB_PERIODS)
+  {
+    printf("Periodic event executed %d times, expected %d\n", count, NB_PERIODS);
+    errors++;
+  }
+
+  if (queued_count)
+  {
+    printf("Cancelled periodic event executed %d times\n", queued_count);
+    errors++;
+  }
+
+  if (after.nb_free != before.nb_free || after.nb_used != before.nb_used)
+  {
+    printf("Periodic event leaked (free: %d -> %d, used: %d -> %d)\n", before.nb_free, after.nb_free, before.nb_used, after.nb_used);
+    errors++;
+  }
+
+  printf("Test %s\n", errors ? "failure" : "success");
+
+  return errors ? -1 : 0;
+}
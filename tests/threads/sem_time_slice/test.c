@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Check that threads blocked on a semaphore are all woken-up when time slicing
+// is enabled. While they are blocked, the waiting threads execute the events of
+// their scheduler and can be preempted in a callback, which puts them in the
+// ready queue while they are still in the semaphore queue.
+
+#include "rt/rt_api.h"
+#include <stdio.h>
+
+#define STACK_SIZE   1024
+#define NB_WAITERS   2
+#define SLICE_US     100
+#define BUSY_US      300
+#define NB_EVENTS    16
+#define TIMEOUT_US   100000
+
+static rt_sem_t sem;
+static rt_thread_t waiters[NB_WAITERS];
+static volatile int nb_woken;
+static volatile int nb_executed;
+
+static void busy_wait(int us)
+{
+  unsigned long long end = rt_time_get_us() + us;
+  while (rt_time_get_us() < end);
+}
+
+// Executed by the blocked threads, and long enough to be preempted
+static void handle_event(void *arg)
+{
+  busy_wait(BUSY_US);
+  nb_executed++;
+}
+
+static void *waiter_entry(void *arg)
+{
+  rt_sem_wait(&sem);
+  nb_woken++;
+  return NULL;
+}
+
+int main()
+{
+  int errors = 0;
+
+  if (rt_event_alloc(NULL, NB_EVENTS)) return -1;
+
+  rt_sem_init(&sem, 0);
+
+  for (int i=0; i<NB_WAITERS; i++)
+  {
+    void *stack = rt_alloc(RT_ALLOC_FC_DATA, STACK_SIZE);
+    if (stack == NULL) return -1;
+    rt_thread_create(&waiters[i], waiter_entry, NULL, (unsigned int)stack, STACK_SIZE);
+  }
+
+  rt_thread_time_slice(SLICE_US);
+
+  // Let the waiters block on the semaphore
+  rt_thread_yield();
+
+  // Give them long events to execute while this thread keeps running
+  // so that they get preempted
+  for (int i=0; i<NB_EVENTS; i++)
+  {
+    rt_event_push(rt_event_get(NULL, handle_event, NULL));
+  }
+
+  busy_wait(NB_EVENTS * BUSY_US * 2);
+
+  for (int i=0; i<NB_WAITERS; i++)
+  {
+    rt_sem_post(&sem);
+  }
+
+  unsigned long long end = rt_time_get_us() + TIMEOUT_US;
+  while (nb_woken != NB_WAITERS && rt_time_get_us() < end)
+  {
+    rt_thread_yield();
+  }
+
+  rt_thread_time_slice(0);
+
+  if (nb_executed != NB_EVENTS)
+  {
+    printf("Only %d events executed out of %d\n", nb_executed, NB_EVENTS);
+    errors++;
+  }
+
+  if (nb_woken != NB_WAITERS)
+  {
+    printf("Only %d threads woken-up out of %d\n", nb_woken, NB_WAITERS);
+    errors++;
+  }
+  else
+  {
+    for (int i=0; i<NB_WAITERS; i++)
+    {
+      rt_thread_join(&waiters[i]);
+    }
+  }
+
+  printf("Test %s\n", errors ? "failure" : "success");
+
+  return errors ? -1 : 0;
+}